@@ -257,7 +257,15 @@ void Array<T>::Reserve(s64 n)
 	{
 		this->capacity = (this->capacity * 2);
 	}
-	this->elements = (T *)this->allocator->Resize(this->elements, this->capacity * sizeof(T));
+	if (this->allocator->ResizeInPlace(this->elements, this->capacity * sizeof(T)))
+	{
+		return;
+	}
+	// Only the elements in use need to be copied, not the whole old capacity.
+	auto e = (T *)this->allocator->Allocate(this->capacity * sizeof(T));
+	Copy(this->View(0, this->count), NewView(e, this->count));
+	this->allocator->Deallocate(this->elements);
+	this->elements = e;
 }
 
 template <typename T>
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "View.h"
+#include "../../Mem/Allocator.h"
+#include "../../Mem/ContextAllocator.h"
+#include "Basic/Assert.h"
+#include "Common.h"
+
+namespace arr
+{
+
+// An array that keeps its first N elements inside the struct and only allocates once it holds more than that. Meant for the many short
+// arrays that almost always hold a handful of elements, where an array would hit the allocator for every one of them.
+//
+// The elements move when the array spills, and copying the struct copies the inline elements, so don't hold on to element pointers across
+// an append or a copy.
+template <typename T, s64 N>
+struct small
+{
+	mem::Allocator *allocator; // Only used once the array spills. Defaults to the context allocator at that point.
+	T *spill; // NULL while the elements are inline.
+	s64 spillCapacity;
+	s64 count;
+	T buffer[N];
+
+	operator view<T>();
+	T &operator[](s64 i);
+	const T &operator[](s64 i) const;
+	T *begin();
+	T *end();
+	T *Elements();
+	s64 Capacity();
+	bool IsSpilled();
+	void Free();
+	void Reserve(s64 n);
+	void Resize(s64 n);
+	void Append(T e);
+	void AppendAll(view<T> a);
+	T Pop();
+	T *Last();
+	view<T> View(s64 start, s64 end);
+};
+
+template <typename T, s64 N>
+small<T, N> NewSmallIn(mem::Allocator *a)
+{
+	return
+	{
+		.allocator = a,
+	};
+}
+
+template <typename T, s64 N>
+small<T, N>::operator view<T>()
+{
+	return
+	{
+		.elements = this->Elements(),
+		.count = this->count,
+	};
+}
+
+template <typename T, s64 N>
+T &small<T, N>::operator[](s64 i)
+{
+	Assert(i >= 0 && i < this->count);
+	return this->Elements()[i];
+}
+
+template <typename T, s64 N>
+const T &small<T, N>::operator[](s64 i) const
+{
+	Assert(i >= 0 && i < this->count);
+	return this->spill ? this->spill[i] : this->buffer[i];
+}
+
+template <typename T, s64 N>
+T *small<T, N>::begin()
+{
+	return this->Elements();
+}
+
+template <typename T, s64 N>
+T *small<T, N>::end()
+{
+	return this->Elements() + this->count;
+}
+
+template <typename T, s64 N>
+T *small<T, N>::Elements()
+{
+	return this->spill ? this->spill : this->buffer;
+}
+
+template <typename T, s64 N>
+s64 small<T, N>::Capacity()
+{
+	return this->spill ? this->spillCapacity : N;
+}
+
+template <typename T, s64 N>
+bool small<T, N>::IsSpilled()
+{
+	return this->spill != NULL;
+}
+
+// Goes back to the inline elements. The allocator is kept.
+template <typename T, s64 N>
+void small<T, N>::Free()
+{
+	if (this->spill)
+	{
+		this->allocator->Deallocate(this->spill);
+	}
+	this->spill = NULL;
+	this->spillCapacity = 0;
+	this->count = 0;
+}
+
+template <typename T, s64 N>
+void small<T, N>::Reserve(s64 n)
+{
+	if (n <= this->Capacity())
+	{
+		return;
+	}
+	if (!this->allocator)
+	{
+		this->allocator = mem::ContextAllocator();
+	}
+	auto cap = (this->Capacity() > 0) ? 2 * this->Capacity() : 1;
+	while (cap < n)
+	{
+		cap *= 2;
+	}
+	if (this->spill)
+	{
+		this->spill = (T *)this->allocator->Resize(this->spill, cap * sizeof(T));
+	}
+	else
+	{
+		this->spill = (T *)this->allocator->Allocate(cap * sizeof(T));
+		for (auto i = 0; i < this->count; i += 1)
+		{
+			this->spill[i] = this->buffer[i];
+		}
+	}
+	this->spillCapacity = cap;
+}
+
+template <typename T, s64 N>
+void small<T, N>::Resize(s64 n)
+{
+	this->Reserve(n);
+	this->count = n;
+}
+
+template <typename T, s64 N>
+void small<T, N>::Append(T e)
+{
+	auto i = this->count;
+	this->Resize(this->count + 1);
+	this->Elements()[i] = e;
+}
+
+template <typename T, s64 N>
+void small<T, N>::AppendAll(view<T> a)
+{
+	auto oldCount = this->count;
+	this->Resize(this->count + a.count);
+	auto es = this->Elements();
+	for (auto i = 0; i < a.count; i += 1)
+	{
+		es[oldCount + i] = a[i];
+	}
+}
+
+template <typename T, s64 N>
+T small<T, N>::Pop()
+{
+	Assert(this->count > 0);
+	this->count -= 1;
+	return this->Elements()[this->count];
+}
+
+template <typename T, s64 N>
+T *small<T, N>::Last()
+{
+	return &(*this)[this->count - 1];
+}
+
+template <typename T, s64 N>
+view<T> small<T, N>::View(s64 start, s64 end)
+{
+	Assert(start <= end);
+	Assert(start >= 0);
+	Assert(end <= this->count);
+	return
+	{
+		.elements = this->Elements() + start,
+		.count = end - start,
+	};
+}
+
+}
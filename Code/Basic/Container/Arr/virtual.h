@@ -0,0 +1,168 @@
+#pragma once
+
+#include "View.h"
+#include "../../Mem/Memory.h"
+#include "../../CPU.h"
+#include "Basic/Assert.h"
+#include "Common.h"
+
+namespace arr
+{
+
+// An array that reserves address space for its maximum count up front and commits pages as it grows. Growing never copies, so pointers to
+// elements stay valid for as long as the array lives. Reserved pages don't cost any memory, and committed pages only do once they are
+// touched, so reserve for the worst case.
+//
+// Committed memory is zeroed, and it is never given back until the array is freed.
+template <typename T>
+struct Virtual
+{
+	T *elements;
+	s64 count;
+	s64 capacity; // Elements that fit in the committed pages.
+	s64 reservedCount;
+
+	operator view<T>();
+	T &operator[](s64 i);
+	const T &operator[](s64 i) const;
+	T *begin();
+	T *end();
+	void Free();
+	void Reserve(s64 n);
+	void Resize(s64 n);
+	T *Append(T e);
+	T Pop();
+	T *Last();
+	view<T> View(s64 start, s64 end);
+};
+
+template <typename T>
+s64 VirtualReservedBytes(s64 count)
+{
+	return (s64)mem::AlignAddress(count * sizeof(T), CPUPageSize());
+}
+
+template <typename T>
+Virtual<T> NewVirtual(s64 reservedCount)
+{
+	Assert(reservedCount > 0);
+	return
+	{
+		.elements = (T *)mem::PlatformReserve(VirtualReservedBytes<T>(reservedCount)),
+		.reservedCount = reservedCount,
+	};
+}
+
+template <typename T>
+Virtual<T>::operator view<T>()
+{
+	return
+	{
+		.elements = this->elements,
+		.count = this->count,
+	};
+}
+
+template <typename T>
+T &Virtual<T>::operator[](s64 i)
+{
+	Assert(i >= 0 && i < this->count);
+	return this->elements[i];
+}
+
+template <typename T>
+const T &Virtual<T>::operator[](s64 i) const
+{
+	Assert(i >= 0 && i < this->count);
+	return this->elements[i];
+}
+
+template <typename T>
+T *Virtual<T>::begin()
+{
+	return &this->elements[0];
+}
+
+template <typename T>
+T *Virtual<T>::end()
+{
+	return &this->elements[this->count - 1] + 1;
+}
+
+template <typename T>
+void Virtual<T>::Free()
+{
+	if (!this->elements)
+	{
+		return;
+	}
+	mem::PlatformDeallocate(this->elements, VirtualReservedBytes<T>(this->reservedCount));
+	*this = {};
+}
+
+// Commits at least twice what is already committed, to keep the number of mprotect calls down. The new pages cost nothing until they are
+// touched.
+template <typename T>
+void Virtual<T>::Reserve(s64 n)
+{
+	if (this->capacity >= n)
+	{
+		return;
+	}
+	if (n > this->reservedCount)
+	{
+		Abort("Array", "Virtual array ran out of reserved space: wanted %d elements, reserved %d.", n, this->reservedCount);
+	}
+	auto oldBytes = VirtualReservedBytes<T>(this->capacity);
+	auto newBytes = VirtualReservedBytes<T>((n > 2 * this->capacity) ? n : 2 * this->capacity);
+	auto maxBytes = VirtualReservedBytes<T>(this->reservedCount);
+	newBytes = (newBytes < maxBytes) ? newBytes : maxBytes;
+	mem::PlatformCommit((u8 *)this->elements + oldBytes, newBytes - oldBytes);
+	this->capacity = newBytes / sizeof(T);
+	this->capacity = (this->capacity < this->reservedCount) ? this->capacity : this->reservedCount;
+}
+
+template <typename T>
+void Virtual<T>::Resize(s64 n)
+{
+	this->Reserve(n);
+	this->count = n;
+}
+
+template <typename T>
+T *Virtual<T>::Append(T e)
+{
+	auto i = this->count;
+	this->Resize(this->count + 1);
+	this->elements[i] = e;
+	return &this->elements[i];
+}
+
+template <typename T>
+T Virtual<T>::Pop()
+{
+	Assert(this->count > 0);
+	this->count -= 1;
+	return this->elements[this->count];
+}
+
+template <typename T>
+T *Virtual<T>::Last()
+{
+	return &(*this)[this->count - 1];
+}
+
+template <typename T>
+view<T> Virtual<T>::View(s64 start, s64 end)
+{
+	Assert(start <= end);
+	Assert(start >= 0);
+	Assert(end <= this->count);
+	return
+	{
+		.elements = &this->elements[start],
+		.count = end - start,
+	};
+}
+
+}
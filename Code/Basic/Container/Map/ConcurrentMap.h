@@ -0,0 +1,123 @@
+#pragma once
+
+#include "Map.h"
+#include "Basic/Thread.h"
+#include "Basic/CPU.h"
+
+// A map that any number of jobs can read and write at once, for registries that are looked up from everywhere and only written now and
+// then. Keys are spread over shards by the top bits of their hash, and each shard is an ordinary map behind its own reader-writer lock.
+// Readers of a shard don't wait on each other, only on a writer to the same shard, and writers to different shards don't wait at all.
+//
+// Values are copied out, since a pointer into a shard could be invalidated by a writer as soon as the lock is released.
+
+const auto ConcurrentMapShardBits = 5;
+const auto ConcurrentMapShardCount = 1 << ConcurrentMapShardBits;
+
+template <typename K, typename V>
+struct concurrentMapShard
+{
+	ReadWriteSpinlock lock;
+	map<K, V> map;
+	u8 padding[CPUCacheLineSize]; // Keeps a shard's lock off of the cache lines of its neighbours.
+};
+
+template <typename K, typename V>
+struct concurrentMap
+{
+	arr::Static<concurrentMapShard<K, V>, ConcurrentMapShardCount> shards;
+	typedef u64 (*hashProcedure)(K);
+	hashProcedure hashProcedure;
+
+	concurrentMapShard<K, V> *Shard(u64 hash);
+	void Insert(K k, V v);
+	bool Lookup(K k, V *v);
+	bool Contains(K k);
+	void Remove(K k);
+	s64 Count();
+};
+
+template <typename K, typename V>
+concurrentMap<K, V> NewConcurrentMapIn(mem::Allocator *a, s64 cap, typename concurrentMap<K, V>::hashProcedure hp)
+{
+	auto m = concurrentMap<K, V>
+	{
+		.hashProcedure = hp,
+	};
+	for (auto &s : m.shards)
+	{
+		s.map = NewMapIn<K, V>(a, cap / ConcurrentMapShardCount, hp);
+	}
+	return m;
+}
+
+template <typename K, typename V>
+concurrentMap<K, V> NewConcurrentMap(s64 cap, typename concurrentMap<K, V>::hashProcedure hp)
+{
+	return NewConcurrentMapIn<K, V>(mem::ContextAllocator(), cap, hp);
+}
+
+// The shard maps pick groups with the bits just above the bottom seven, so the top bits are free to pick the shard.
+template <typename K, typename V>
+concurrentMapShard<K, V> *concurrentMap<K, V>::Shard(u64 hash)
+{
+	return &this->shards[hash >> (64 - ConcurrentMapShardBits)];
+}
+
+template <typename K, typename V>
+void concurrentMap<K, V>::Insert(K k, V v)
+{
+	auto s = this->Shard(MapMixHash(this->hashProcedure(k)));
+	s->lock.Lock();
+	Defer(s->lock.Unlock());
+	s->map.Insert(k, v);
+}
+
+// Copies the value into v and returns true if k is in the map.
+template <typename K, typename V>
+bool concurrentMap<K, V>::Lookup(K k, V *v)
+{
+	auto h = MapMixHash(this->hashProcedure(k));
+	auto s = this->Shard(h);
+	s->lock.LockShared();
+	Defer(s->lock.UnlockShared());
+	auto i = s->map.Find(h, k);
+	if (i < 0)
+	{
+		return false;
+	}
+	*v = s->map.buckets[i].value;
+	return true;
+}
+
+template <typename K, typename V>
+bool concurrentMap<K, V>::Contains(K k)
+{
+	auto h = MapMixHash(this->hashProcedure(k));
+	auto s = this->Shard(h);
+	s->lock.LockShared();
+	Defer(s->lock.UnlockShared());
+	return s->map.Find(h, k) >= 0;
+}
+
+template <typename K, typename V>
+void concurrentMap<K, V>::Remove(K k)
+{
+	auto s = this->Shard(MapMixHash(this->hashProcedure(k)));
+	s->lock.Lock();
+	Defer(s->lock.Unlock());
+	s->map.Remove(k);
+}
+
+// Only a snapshot if other jobs are writing.
+template <typename K, typename V>
+s64 concurrentMap<K, V>::Count()
+{
+	auto n = s64{0};
+	for (auto &s : this->shards)
+	{
+		s.lock.LockShared();
+		n += s.map.count;
+		s.lock.UnlockShared();
+	}
+	return n;
+}
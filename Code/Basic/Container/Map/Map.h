@@ -1,10 +1,19 @@
 #pragma once
 
-// @TODO: Change the default values to 0 and 1 for easier intitialization.
-const auto VacantHashSentinel = (u64)-1;
-const auto DeletedHashSentinel = (u64)-2;
+#include <emmintrin.h>
+
+// An open addressing hash map in the style of Swiss tables. Every slot has a control byte: the low seven bits of the key's hash if the slot
+// is full, or MapEmpty or MapDeleted. Slots are probed a group of sixteen at a time, comparing all sixteen control bytes at once with SSE2,
+// so a lookup usually touches one cache line of control bytes and compares only the keys whose control byte matches.
+//
+// Groups are aligned and visited in quadratic order, and a lookup stops at the first group with an empty slot. That means a removed slot
+// can go straight back to empty if its group still has another empty slot, since no lookup could have probed past the group. Only slots in
+// full groups become MapDeleted, and those are cleared out when the table is rebuilt.
+
+const auto MapGroupSize = 16;
+const auto MapEmpty = (s8)-128;
+const auto MapDeleted = (s8)-2;
 const auto DefaultInitialLength = 16;
-const auto MaxLoadFactor = 0.75f;
 
 template <typename K, typename V>
 struct keyValue
@@ -18,38 +27,74 @@ template <typename K, typename V> struct iterator;
 template <typename K, typename V>
 struct map
 {
-	arr::array<u64> hashes;
+	arr::array<s8> controls;
 	arr::array<keyValue<K, V>> buckets;
 	typedef u64 (*hashProcedure)(K);
 	hashProcedure hashProcedure;
 	s64 count;
-	f32 loadFactor;
+	s64 growthLeft; // How many empty slots can be filled before the table has to grow or be rebuilt.
 
 	iterator<K, V> begin();
 	iterator<K, V> end();
 	void DoInsert(u64 hash, K k, V v);
 	void Insert(K k, V v);
-	V *DoLookup(K k);
+	s64 Find(u64 hash, K k);
 	V *Lookup(K k);
 	void Remove(K k);
 	void Clear();
 	void ClearAndResize(s64 len);
 	void Reserve(s64 count);
-	void Resize();
+	void Rebuild(s64 cap);
 };
 
+// The table is kept at most seven eighths full.
+inline s64 MapMaxCount(s64 cap)
+{
+	return cap - (cap / 8);
+}
+
+// Rounds up to a power of two number of groups.
+inline s64 MapCapacity(s64 count)
+{
+	auto cap = s64{MapGroupSize};
+	while (MapMaxCount(cap) < count)
+	{
+		cap *= 2;
+	}
+	return cap;
+}
+
+inline u32 MapMatchByte(s8 *group, s8 b)
+{
+	auto g = _mm_loadu_si128((__m128i *)group);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(b), g));
+}
+
+// Hash procedures like plain integer hashes leave the high bits empty, and the high bits pick the group, so spread them out.
+inline u64 MapMixHash(u64 h)
+{
+	h *= 0x9E3779B97F4A7C15ull;
+	return h ^ (h >> 32);
+}
+
+// Empty and deleted control bytes are the only ones with the sign bit set.
+inline u32 MapMatchEmptyOrDeleted(s8 *group)
+{
+	return _mm_movemask_epi8(_mm_loadu_si128((__m128i *)group));
+}
+
 template <typename K, typename V>
-map<K, V> NewMapIn(Allocator *a, s64 cap, typename map<K, V>::hashProcedure hp)
+map<K, V> NewMapIn(mem::Allocator *a, s64 cap, typename map<K, V>::hashProcedure hp)
 {
 	auto m = map<K, V>
 	{
-		.hashes = NewArrayIn<u64>(a, cap),
-		.buckets = NewArrayIn<KeyValue<K, V>>(a, cap),
+		.controls = arr::NewWithCapacityIn<s8>(a, 0),
+		.buckets = arr::NewWithCapacityIn<keyValue<K, V>>(a, 0),
 		.hashProcedure = hp,
 	};
-	for (auto &h : m.hashes)
+	if (cap > 0)
 	{
-		h = VacantHashSentinel;
+		m.ClearAndResize(MapCapacity(cap));
 	}
 	return m;
 }
@@ -57,7 +102,7 @@ map<K, V> NewMapIn(Allocator *a, s64 cap, typename map<K, V>::hashProcedure hp)
 template <typename K, typename V>
 map<K, V> NewMap(s64 cap, typename map<K, V>::hashProcedure p)
 {
-	return NewMapIn<K, V>(ContextAllocator(), cap, p);
+	return NewMapIn<K, V>(mem::ContextAllocator(), cap, p);
 }
 
 template <typename K, typename V>
@@ -81,34 +126,62 @@ iterator<K, V> map<K, V>::end()
 	};
 }
 
+// Returns the slot holding k, or -1.
 template <typename K, typename V>
-void map<K, V>::DoInsert(u64 hash, K k, V v)
+s64 map<K, V>::Find(u64 hash, K k)
 {
-	if (hash == VacantHashSentinel)
+	if (this->buckets.count == 0)
 	{
-		hash = 0;
+		return -1;
 	}
-	else if (hash == DeletedHashSentinel)
+	auto h2 = (s8)(hash & 0x7F);
+	auto groupMask = (this->buckets.count / MapGroupSize) - 1;
+	auto g = (s64)(hash >> 7) & groupMask;
+	for (auto step = 1; step <= groupMask + 1; step += 1)
 	{
-		hash = 1;
+		auto group = &this->controls[g * MapGroupSize];
+		for (auto m = MapMatchByte(group, h2); m; m &= m - 1)
+		{
+			auto i = (g * MapGroupSize) + __builtin_ctz(m);
+			if (this->buckets[i].key == k)
+			{
+				return i;
+			}
+		}
+		if (MapMatchByte(group, MapEmpty))
+		{
+			return -1;
+		}
+		g = (g + step) & groupMask;
 	}
-	auto i = hash % this->buckets.count;
-	auto end = i;
-	do
+	return -1;
+}
+
+// Assumes the key isn't in the table and that there is room for it.
+template <typename K, typename V>
+void map<K, V>::DoInsert(u64 hash, K k, V v)
+{
+	auto groupMask = (this->buckets.count / MapGroupSize) - 1;
+	auto g = (s64)(hash >> 7) & groupMask;
+	for (auto step = 1;; step += 1)
 	{
-		if (this->hashes[i] == VacantHashSentinel || (this->hashes[i] == hash && this->buckets[i].key == k))
+		auto group = &this->controls[g * MapGroupSize];
+		if (auto m = MapMatchEmptyOrDeleted(group); m)
 		{
-			this->hashes[i] = hash;
-			this->buckets[i].key = k;
-			this->buckets[i].value = v;
+			auto i = (g * MapGroupSize) + __builtin_ctz(m);
+			if (this->controls[i] == MapEmpty)
+			{
+				this->growthLeft -= 1;
+			}
+			this->controls[i] = (s8)(hash & 0x7F);
+			this->buckets[i] = {k, v};
 			this->count += 1;
-			this->loadFactor = (f32)this->count / (f32)this->buckets.count;
 			return;
 		}
-		i = (i + 1) % this->buckets.count;
-		// The table should expand before we run out of space, so we never wrap around to the start index.
-		Assert(i != end);
-	} while (i != end);
+		// Quadratic probing visits every group when the group count is a power of two, and the table is never full.
+		Assert(step <= groupMask + 1);
+		g = (g + step) & groupMask;
+	}
 }
 
 template <typename K, typename V>
@@ -116,101 +189,110 @@ void map<K, V>::Insert(K k, V v)
 {
 	// The user has to set the hash procedure, even if the Map is zero-initialized.
 	Assert(this->hashProcedure);
+	auto h = MapMixHash(this->hashProcedure(k));
+	if (auto i = this->Find(h, k); i >= 0)
+	{
+		this->buckets[i].value = v;
+		return;
+	}
 	this->Reserve(this->count + 1);
-	auto h = this->hashProcedure(k);
 	this->DoInsert(h, k, v);
 }
 
 template <typename K, typename V>
 V *map<K, V>::Lookup(K k)
 {
-	if (this->buckets.count == 0)
+	if (this->count == 0)
 	{
 		return NULL;
 	}
-	auto hash = this->hashProcedure(k);
-	if (hash == VacantHashSentinel)
-	{
-		hash = 0;
-	}
-	else if (hash == DeletedHashSentinel)
+	auto i = this->Find(MapMixHash(this->hashProcedure(k)), k);
+	if (i < 0)
 	{
-		hash = 1;
+		return NULL;
 	}
-	auto i = hash % this->buckets.count;
-	auto end = i;
-	do
-	{
-		if (this->hashes[i] == VacantHashSentinel)
-		{
-			return NULL;
-		}
-		else if (this->hashes[i] == hash && this->buckets[i].key == k)
-		{
-			return &this->buckets[i].value;
-		}
-		i = (i + 1) % this->buckets.count;
-	} while (i != end);
-	return NULL;
+	return &this->buckets[i].value;
 }
 
 template <typename K, typename V>
 void map<K, V>::Remove(K k)
 {
-	// @TODO
+	if (this->count == 0)
+	{
+		return;
+	}
+	auto i = this->Find(MapMixHash(this->hashProcedure(k)), k);
+	if (i < 0)
+	{
+		return;
+	}
+	this->count -= 1;
+	if (MapMatchByte(&this->controls[i - (i % MapGroupSize)], MapEmpty))
+	{
+		this->controls[i] = MapEmpty;
+		this->growthLeft += 1;
+		return;
+	}
+	this->controls[i] = MapDeleted;
 }
 
 template <typename K, typename V>
 void map<K, V>::Clear()
 {
 	this->count = 0;
-	for (auto &hash : this->hashes)
+	for (auto &c : this->controls)
 	{
-		hash = VacantHashSentinel;
+		c = MapEmpty;
 	}
+	this->growthLeft = MapMaxCount(this->buckets.count);
 }
 
 template <typename K, typename V>
 void map<K, V>::ClearAndResize(s64 len)
 {
-	this->count = 0;
+	Assert(len % MapGroupSize == 0 && (len & (len - 1)) == 0);
+	this->controls.Resize(len);
 	this->buckets.Resize(len);
-	for (auto &hash : this->hashes)
-	{
-		hash = VacantHashSentinel;
-	}
+	this->Clear();
 }
 
 template <typename K, typename V>
 void map<K, V>::Reserve(s64 reserve)
 {
-	if (this->buckets.count > reserve)
+	if (this->buckets.count == 0)
 	{
+		this->ClearAndResize(MapCapacity((reserve > DefaultInitialLength) ? reserve : DefaultInitialLength));
 		return;
 	}
-	if (this->buckets.count == 0)
+	auto need = reserve - this->count;
+	if (need <= this->growthLeft)
 	{
-		this->hashes.Resize(reserve * 2);
-		for (auto &h : this->hashes)
-		{
-			h = VacantHashSentinel;
-		}
-		this->buckets.Resize(reserve * 2);
 		return;
 	}
-	if ((f32)reserve / (f32)this->buckets.count <= MaxLoadFactor)
+	// Out of empty slots. If the elements would fit in half of the table, most of the missing room is deleted slots, so rebuilding at the
+	// same size is enough to clear them out. Otherwise grow.
+	if (reserve <= MapMaxCount(this->buckets.count) / 2)
 	{
+		this->Rebuild(this->buckets.count);
 		return;
 	}
-	auto newMap = NewMapIn<K, V>(this->buckets.allocator, reserve * 2, this->hashProcedure);
+	this->Rebuild(MapCapacity(reserve * 2));
+}
+
+template <typename K, typename V>
+void map<K, V>::Rebuild(s64 cap)
+{
+	auto newMap = NewMapIn<K, V>(this->buckets.allocator, 0, this->hashProcedure);
+	newMap.ClearAndResize(cap);
 	for (auto i = 0; i < this->buckets.count; i += 1)
 	{
-		if (this->hashes[i] == VacantHashSentinel || this->hashes[i] == DeletedHashSentinel)
+		if (this->controls[i] >= 0)
 		{
-			continue;
+			newMap.DoInsert(MapMixHash(this->hashProcedure(this->buckets[i].key)), this->buckets[i].key, this->buckets[i].value);
 		}
-		newMap.DoInsert(this->hashes[i], this->buckets[i].key, this->buckets[i].value);
 	}
+	this->controls.Free();
+	this->buckets.Free();
 	*this = newMap;
 }
 
@@ -231,7 +313,7 @@ iterator<K, V> iterator<K, V>::operator++()
 	this->index += 1;
 	for (; this->index < this->map->buckets.count; this->index += 1)
 	{
-		if (this->map->hashes[this->index] != VacantHashSentinel && this->map->hashes[this->index] != DeletedHashSentinel)
+		if (this->map->controls[this->index] >= 0)
 		{
 			break;
 		}
@@ -244,7 +326,7 @@ iterator<K, V> iterator<K, V>::operator++()
 }
 
 template <typename K, typename V>
-KeyValue<K, V> iterator<K, V>::operator*()
+keyValue<K, V> iterator<K, V>::operator*()
 {
 	return this->map->buckets[this->index];
 }
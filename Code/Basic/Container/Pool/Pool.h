@@ -1,14 +1,19 @@
 #pragma once
 
 #include "Basic/Container/Arr.h"
+#include "Basic/Container/Arr/virtual.h"
 
 namespace pool
 {
 
+// Address space reserved for each pool's elements. Only the pages the pool grows into are ever committed.
+const auto PoolReservedBytes = 4ll * Gigabyte;
+
+// The elements live in a virtual array, so growing the pool doesn't move them and the pointers it has handed out stay valid.
 template <typename T>
 struct pool
 {
-	arr::array<T> elements;
+	arr::Virtual<T> elements;
 	arr::array<T *> freeList;
 
 	void SetAllocator(mem::allocator *a);
@@ -22,9 +27,10 @@ pool<T> NewIn(mem::allocator *a, s64 cap)
 {
 	auto p = pool<T>
 	{
-		.elements = arr::NewIn<T>(a, cap),
+		.elements = arr::NewVirtual<T>(PoolReservedBytes / sizeof(T)),
 		.freeList = arr::NewWithCapacityIn<T *>(a, cap),
 	};
+	p.elements.Resize(cap);
 	for (auto &e : p.elements)
 	{
 		e = {};
@@ -45,7 +51,6 @@ pool<T> New(s64 size)
 template <typename T>
 void pool<T>::SetAllocator(mem::allocator *a)
 {
-	this->elements.SetAllocator(a);
 	this->freeList.SetAllocator(a);
 }
 
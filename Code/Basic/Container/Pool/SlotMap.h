@@ -0,0 +1,189 @@
+#pragma once
+
+#include "Basic/Container/Array.h"
+
+namespace pool
+{
+
+// A slot map hands out handles to its elements instead of pointers. A handle is a slot index plus the generation of that slot when the
+// element was inserted. Removing an element bumps its slot's generation, so old handles to the slot stop matching and lookups through them
+// fail, even after the slot is reused. Insert, Remove and Lookup are a couple of array accesses each, with no hashing.
+//
+// The elements are packed together in values, so iterating over them is a plain array walk. Removing moves the last element into the hole,
+// so element pointers are only good until the next Insert or Remove. Hold on to handles instead.
+
+// Generations start at one, so a zeroed handle never matches anything.
+struct handle
+{
+	u32 index;
+	u32 generation;
+};
+
+const auto NullHandle = handle{};
+const auto NoFreeSlot = u32(-1);
+
+struct slot
+{
+	u32 generation;
+	u32 valueIndex; // If the slot is free, the next free slot instead.
+};
+
+template <typename T>
+struct slotMap
+{
+	arr::array<T> values;
+	arr::array<u32> valueSlots; // The slot each value belongs to, for patching up the slot when Remove moves a value.
+	arr::array<slot> slots;
+	u32 freeSlots; // Head of the free list threaded through valueIndex, or NoFreeSlot.
+
+	T *begin();
+	T *end();
+	handle Insert(T e);
+	T *Lookup(handle h);
+	bool Contains(handle h);
+	bool Remove(handle h);
+	handle HandleAt(s64 valueIndex);
+	s64 Count();
+	void Clear();
+	void Free();
+};
+
+template <typename T>
+slotMap<T> NewSlotMapIn(mem::Allocator *a, s64 cap)
+{
+	return
+	{
+		.values = arr::NewWithCapacityIn<T>(a, cap),
+		.valueSlots = arr::NewWithCapacityIn<u32>(a, cap),
+		.slots = arr::NewWithCapacityIn<slot>(a, cap),
+		.freeSlots = NoFreeSlot,
+	};
+}
+
+template <typename T>
+slotMap<T> NewSlotMap(s64 cap)
+{
+	return NewSlotMapIn<T>(mem::ContextAllocator(), cap);
+}
+
+template <typename T>
+T *slotMap<T>::begin()
+{
+	return this->values.begin();
+}
+
+template <typename T>
+T *slotMap<T>::end()
+{
+	return this->values.end();
+}
+
+template <typename T>
+handle slotMap<T>::Insert(T e)
+{
+	auto si = this->freeSlots;
+	if (si == NoFreeSlot)
+	{
+		Assert(this->slots.count < NoFreeSlot);
+		si = this->slots.count;
+		this->slots.Append(
+		{
+			.generation = 1,
+		});
+	}
+	else
+	{
+		this->freeSlots = this->slots[si].valueIndex;
+	}
+	auto s = &this->slots[si];
+	s->valueIndex = this->values.count;
+	this->values.Append(e);
+	this->valueSlots.Append(si);
+	return
+	{
+		.index = si,
+		.generation = s->generation,
+	};
+}
+
+template <typename T>
+bool slotMap<T>::Contains(handle h)
+{
+	return h.index < this->slots.count && this->slots[h.index].generation == h.generation;
+}
+
+// Returns NULL if the handle's element was removed.
+template <typename T>
+T *slotMap<T>::Lookup(handle h)
+{
+	if (!this->Contains(h))
+	{
+		return NULL;
+	}
+	return &this->values[this->slots[h.index].valueIndex];
+}
+
+// Returns false if the handle's element was already removed.
+template <typename T>
+bool slotMap<T>::Remove(handle h)
+{
+	if (!this->Contains(h))
+	{
+		return false;
+	}
+	auto s = &this->slots[h.index];
+	auto i = s->valueIndex;
+	auto last = this->values.count - 1;
+	this->values[i] = this->values[last];
+	this->valueSlots[i] = this->valueSlots[last];
+	this->slots[this->valueSlots[i]].valueIndex = i;
+	this->values.Resize(last);
+	this->valueSlots.Resize(last);
+	s->generation += 1;
+	if (s->generation == 0)
+	{
+		s->generation = 1;
+	}
+	s->valueIndex = this->freeSlots;
+	this->freeSlots = h.index;
+	return true;
+}
+
+// The handle of the element at values[valueIndex], for walking the packed values and getting back handles.
+template <typename T>
+handle slotMap<T>::HandleAt(s64 valueIndex)
+{
+	auto si = this->valueSlots[valueIndex];
+	return
+	{
+		.index = si,
+		.generation = this->slots[si].generation,
+	};
+}
+
+template <typename T>
+s64 slotMap<T>::Count()
+{
+	return this->values.count;
+}
+
+// Removes every element. Handles from before the clear stay stale.
+template <typename T>
+void slotMap<T>::Clear()
+{
+	while (this->values.count > 0)
+	{
+		this->Remove(this->HandleAt(this->values.count - 1));
+	}
+}
+
+template <typename T>
+void slotMap<T>::Free()
+{
+	this->values.Free();
+	this->valueSlots.Free();
+	this->slots.Free();
+	this->freeSlots = NoFreeSlot;
+}
+
+}
@@ -0,0 +1,307 @@
+#pragma once
+
+#include "Basic/Container/Array.h"
+#include "Basic/Mem/Allocator.h"
+#include "Basic/Mem/ContextAllocator.h"
+#include "Basic/Atomic.h"
+#include "Basic/CPU.h"
+#include "Basic/Assert.h"
+
+// Fixed size ring buffer queues that threads can push to and pop from without taking a lock. Pushing to a full queue or popping from an
+// empty one fails instead of waiting, so callers decide whether to spin, fall back to something else, or do the work themselves.
+//
+// The capacity must be a power of two. Elements are copied in and out, so keep them small (pointers or handles).
+
+namespace queue
+{
+
+// Any number of producers and consumers (Dmitry Vyukov's bounded MPMC queue). Every cell has a sequence number that says whose turn it is:
+// a cell at position p is ready to be written when its sequence is p, and ready to be read when it is p + 1. A producer claims a position
+// by advancing the enqueue position with a compare and swap, writes the element, then publishes it by bumping the sequence. Consumers do
+// the same on the other side, and set the sequence to p + capacity to hand the cell to the producer one lap later. Producers only contend
+// with producers and consumers only with consumers, on their own cache lines.
+template <typename T>
+struct MPMCCell
+{
+	volatile s64 sequence;
+	T value;
+};
+
+template <typename T>
+struct MPMC
+{
+	mem::Allocator *allocator;
+	MPMCCell<T> *cells;
+	s64 mask;
+	u8 padding0[CPUCacheLineSize - sizeof(mem::Allocator *) - sizeof(MPMCCell<T> *) - sizeof(s64)];
+	volatile s64 enqueuePosition;
+	u8 padding1[CPUCacheLineSize - sizeof(s64)];
+	volatile s64 dequeuePosition;
+	u8 padding2[CPUCacheLineSize - sizeof(s64)];
+
+	bool Push(T e);
+	bool Pop(T *e);
+	s64 PushBatch(arr::view<T> es);
+	s64 PopBatch(arr::view<T> out);
+	s64 Capacity();
+	s64 Count();
+	void Free();
+};
+
+template <typename T>
+MPMC<T> NewMPMCIn(mem::Allocator *a, s64 cap)
+{
+	Assert(cap > 0 && (cap & (cap - 1)) == 0);
+	auto q = MPMC<T>
+	{
+		.allocator = a,
+		.cells = (MPMCCell<T> *)a->AllocateAligned(cap * sizeof(MPMCCell<T>), CPUCacheLineSize),
+		.mask = cap - 1,
+	};
+	for (auto i = 0; i < cap; i += 1)
+	{
+		q.cells[i].sequence = i;
+	}
+	return q;
+}
+
+template <typename T>
+MPMC<T> NewMPMC(s64 cap)
+{
+	return NewMPMCIn<T>(mem::ContextAllocator(), cap);
+}
+
+template <typename T>
+bool MPMC<T>::Push(T e)
+{
+	return this->PushBatch(arr::NewView(&e, 1)) == 1;
+}
+
+template <typename T>
+bool MPMC<T>::Pop(T *e)
+{
+	return this->PopBatch(arr::NewView(e, 1)) == 1;
+}
+
+// Pushes as many of es as there is room for, in order, and returns how many were pushed. A batch claims all of its cells with one compare
+// and swap.
+template <typename T>
+s64 MPMC<T>::PushBatch(arr::view<T> es)
+{
+	auto pos = __atomic_load_n(&this->enqueuePosition, __ATOMIC_RELAXED);
+	while (true)
+	{
+		// Count the cells after pos that consumers are done with. Once a cell is seen free, it stays free until someone claims its
+		// position.
+		auto n = s64{0};
+		for (; n < es.count; n += 1)
+		{
+			auto c = &this->cells[(pos + n) & this->mask];
+			if (__atomic_load_n(&c->sequence, __ATOMIC_ACQUIRE) != pos + n)
+			{
+				break;
+			}
+		}
+		if (n == 0)
+		{
+			auto c = &this->cells[pos & this->mask];
+			if (__atomic_load_n(&c->sequence, __ATOMIC_ACQUIRE) < pos)
+			{
+				return 0; // Full: the cell still holds the element from the last lap.
+			}
+			// Another producer claimed pos first.
+			pos = __atomic_load_n(&this->enqueuePosition, __ATOMIC_RELAXED);
+			continue;
+		}
+		auto old = AtomicCompareAndSwap64(&this->enqueuePosition, pos, pos + n);
+		if (old != pos)
+		{
+			pos = old;
+			continue;
+		}
+		for (auto i = 0; i < n; i += 1)
+		{
+			auto c = &this->cells[(pos + i) & this->mask];
+			c->value = es[i];
+			__atomic_store_n(&c->sequence, pos + i + 1, __ATOMIC_RELEASE);
+		}
+		return n;
+	}
+}
+
+// Pops up to out.count elements into out, in order, and returns how many were popped.
+template <typename T>
+s64 MPMC<T>::PopBatch(arr::view<T> out)
+{
+	auto pos = __atomic_load_n(&this->dequeuePosition, __ATOMIC_RELAXED);
+	while (true)
+	{
+		auto n = s64{0};
+		for (; n < out.count; n += 1)
+		{
+			auto c = &this->cells[(pos + n) & this->mask];
+			if (__atomic_load_n(&c->sequence, __ATOMIC_ACQUIRE) != pos + n + 1)
+			{
+				break;
+			}
+		}
+		if (n == 0)
+		{
+			auto c = &this->cells[pos & this->mask];
+			if (__atomic_load_n(&c->sequence, __ATOMIC_ACQUIRE) < pos + 1)
+			{
+				return 0; // Empty, or the producer of pos hasn't finished writing it.
+			}
+			pos = __atomic_load_n(&this->dequeuePosition, __ATOMIC_RELAXED);
+			continue;
+		}
+		auto old = AtomicCompareAndSwap64(&this->dequeuePosition, pos, pos + n);
+		if (old != pos)
+		{
+			pos = old;
+			continue;
+		}
+		for (auto i = 0; i < n; i += 1)
+		{
+			auto c = &this->cells[(pos + i) & this->mask];
+			out[i] = c->value;
+			__atomic_store_n(&c->sequence, pos + i + this->mask + 1, __ATOMIC_RELEASE);
+		}
+		return n;
+	}
+}
+
+template <typename T>
+s64 MPMC<T>::Capacity()
+{
+	return this->mask + 1;
+}
+
+// Only a snapshot if other threads are pushing or popping.
+template <typename T>
+s64 MPMC<T>::Count()
+{
+	auto n = __atomic_load_n(&this->enqueuePosition, __ATOMIC_RELAXED) - __atomic_load_n(&this->dequeuePosition, __ATOMIC_RELAXED);
+	return (n > 0) ? n : 0;
+}
+
+template <typename T>
+void MPMC<T>::Free()
+{
+	this->allocator->Deallocate(this->cells);
+	*this = {};
+}
+
+// Exactly one producer thread and one consumer thread. Each side owns its position and keeps a cached copy of the other side's, so it only
+// touches the other side's cache line when the cached copy says the queue is full (or empty).
+template <typename T>
+struct SPSC
+{
+	mem::Allocator *allocator;
+	T *elements;
+	s64 mask;
+	u8 padding0[CPUCacheLineSize - sizeof(mem::Allocator *) - sizeof(T *) - sizeof(s64)];
+	volatile s64 tail; // Written by the producer.
+	s64 cachedHead;
+	u8 padding1[CPUCacheLineSize - 2 * sizeof(s64)];
+	volatile s64 head; // Written by the consumer.
+	s64 cachedTail;
+	u8 padding2[CPUCacheLineSize - 2 * sizeof(s64)];
+
+	bool Push(T e);
+	bool Pop(T *e);
+	s64 PushBatch(arr::view<T> es);
+	s64 PopBatch(arr::view<T> out);
+	s64 Capacity();
+	s64 Count();
+	void Free();
+};
+
+template <typename T>
+SPSC<T> NewSPSCIn(mem::Allocator *a, s64 cap)
+{
+	Assert(cap > 0 && (cap & (cap - 1)) == 0);
+	return
+	{
+		.allocator = a,
+		.elements = (T *)a->AllocateAligned(cap * sizeof(T), CPUCacheLineSize),
+		.mask = cap - 1,
+	};
+}
+
+template <typename T>
+SPSC<T> NewSPSC(s64 cap)
+{
+	return NewSPSCIn<T>(mem::ContextAllocator(), cap);
+}
+
+template <typename T>
+bool SPSC<T>::Push(T e)
+{
+	return this->PushBatch(arr::NewView(&e, 1)) == 1;
+}
+
+template <typename T>
+bool SPSC<T>::Pop(T *e)
+{
+	return this->PopBatch(arr::NewView(e, 1)) == 1;
+}
+
+template <typename T>
+s64 SPSC<T>::PushBatch(arr::view<T> es)
+{
+	auto tail = this->tail;
+	auto cap = this->mask + 1;
+	if (tail + es.count - this->cachedHead > cap)
+	{
+		this->cachedHead = __atomic_load_n(&this->head, __ATOMIC_ACQUIRE);
+	}
+	auto n = cap - (tail - this->cachedHead);
+	n = (n < es.count) ? n : es.count;
+	for (auto i = 0; i < n; i += 1)
+	{
+		this->elements[(tail + i) & this->mask] = es[i];
+	}
+	__atomic_store_n(&this->tail, tail + n, __ATOMIC_RELEASE);
+	return n;
+}
+
+template <typename T>
+s64 SPSC<T>::PopBatch(arr::view<T> out)
+{
+	auto head = this->head;
+	if (this->cachedTail - head < out.count)
+	{
+		this->cachedTail = __atomic_load_n(&this->tail, __ATOMIC_ACQUIRE);
+	}
+	auto n = this->cachedTail - head;
+	n = (n < out.count) ? n : out.count;
+	for (auto i = 0; i < n; i += 1)
+	{
+		out[i] = this->elements[(head + i) & this->mask];
+	}
+	__atomic_store_n(&this->head, head + n, __ATOMIC_RELEASE);
+	return n;
+}
+
+template <typename T>
+s64 SPSC<T>::Capacity()
+{
+	return this->mask + 1;
+}
+
+// Only a snapshot if the other side is running.
+template <typename T>
+s64 SPSC<T>::Count()
+{
+	return __atomic_load_n(&this->tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&this->head, __ATOMIC_ACQUIRE);
+}
+
+template <typename T>
+void SPSC<T>::Free()
+{
+	this->allocator->Deallocate(this->elements);
+	*this = {};
+}
+
+}
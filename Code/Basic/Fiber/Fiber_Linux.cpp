@@ -18,399 +18,115 @@ namespace fiber
 //    __tsan_get_current_fiber()
 //    __tsan_set_fiber_name()
 
-const auto StackSize = 100 * cpu::PageSize();
 const auto StackGuardPageCount = 1;
-const auto StackPlusGuardSize = StackSize + (StackGuardPageCount * cpu::PageSize());
 
+#ifndef UContextFiberBuild
 #if __x86_64__
-#if 0
+	// Switches fibers by saving the callee-saved registers (and the SSE and x87 control words, which the SysV ABI also treats as
+	// callee-saved) onto the current stack, storing the stack pointer in from, and doing the reverse with the stack pointer in to.
+	// Unlike swapcontext, this never makes a syscall and doesn't save the full FPU state.
 	__asm(R"(
-		.type GetPlatformContext, @function
-		.global GetPlatformContext
-		GetPlatformContext:
-			# Save the return address and stack pointer.
-			movq (%rsp), %r8
-			movq %r8, 8*0(%rdi) // RIP
-			leaq 8(%rsp), %r8
-			movq %r8, 8*1(%rdi) // RSP
-			# Save preserved registers.
-			movq %rbx, 8*2(%rdi)
-			movq %rbp, 8*3(%rdi)
-			movq %r12, 8*4(%rdi)
-			movq %r13, 8*5(%rdi)
-			movq %r14, 8*6(%rdi)
-			movq %r15, 8*7(%rdi)
-			# Return.
-			xorl %eax, %eax
-			ret)");
-
-		__asm(R"(
-		.type SetPlatformContext, @function
-		.global SetPlatformContext
-		SetPlatformContext:
-			# Should return to the address set with {get, swap}_context.
-			movq 8*0(%rdi), %r8
-			# Load new stack pointer.
-			movq 8*1(%rdi), %rsp
-			# Load preserved registers.
-			movq 8*2(%rdi), %rbx
-			movq 8*3(%rdi), %rbp
-			movq 8*4(%rdi), %r12
-			movq 8*5(%rdi), %r13
-			movq 8*6(%rdi), %r14
-			movq 8*7(%rdi), %r15
-			# Push RIP to stack for RET.
-			pushq %r8
-			# Return.
-			xorl %eax, %eax
-			ret)");
-
-		__asm(R"(
-		.type SwapPlatformContext, @function
-		.global SwapPlatformContext
-		SwapPlatformContext:
-			# Save the return address.
-			movq (%rsp), %r8
-			movq %r8, 8*0(%rdi) // RIP
-			leaq 8(%rsp), %r8
-			movq %r8, 8*1(%rdi) // RSP
-			# Save preserved registers.
-			movq %rbx, 8*2(%rdi)
-			movq (%rbp), %r8
-			movq %r8, 8*3(%rdi)
-			movq %r12, 8*4(%rdi)
-			movq %r13, 8*5(%rdi)
-			movq %r14, 8*6(%rdi)
-			movq %r15, 8*7(%rdi)
-			# Should return to the address set with {get, swap}_context.
-			movq 8*0(%rsi), %r8
-			# Load new stack pointer.
-			movq 8*1(%rsi), %rsp
-			# Align the pointer for some reason, not sure.
-			leaq -0x8(%rsp), %rsp
-			# Load preserved registers.
-			movq 8*2(%rsi), %rbx
-			movq 8*3(%rsi), %rbp
-			movq 8*4(%rsi), %r12
-			movq 8*5(%rsi), %r13
-			movq 8*6(%rsi), %r14
-			movq 8*7(%rsi), %r15
-			# Set the argument.
-			movq %rdx, %rdi
-			# Push RIP to stack for RET.
-			pushq %r8
-			# Return.
-			xorl %eax, %eax
-			ret)");
-#endif
-
-#if 0
-__attribute__((section(".text")))
-static u8 SetPlatformContextCode[] =
-{
-0x4c, 0x8b, 0x07,
-0x48, 0x8b, 0x67, 0x08,
-0x48, 0x8b, 0x5f, 0x10,
-0x48, 0x8b, 0x6f, 0x18,
-0x4c, 0x8b, 0x67, 0x20,
-0x4c, 0x8b, 0x6f, 0x28,
-0x4c, 0x8b, 0x77, 0x30,
-0x4c, 0x8b, 0x7f, 0x38,
-0x41, 0x50,
-0x31, 0xc0,
-0xc3,
-};
-
-__attribute__((section(".text")))
-static u8 SwapPlatformContextCode[] =
-{
-#if 0
-	0x4c, 0x8b, 0x04, 0x24,
-	0x4c, 0x89, 0x07,
-	0x4c, 0x8d, 0x44, 0x24, 0x08,
-	0x4c, 0x89, 0x47, 0x08,
-	0x48, 0x89, 0x5f, 0x10,
-	0x4c, 0x8b, 0x45, 0x00,
-	0x4c, 0x89, 0x47, 0x18,
-	0x4c, 0x89, 0x67, 0x20,
-	0x4c, 0x89, 0x6f, 0x28,
-	0x4c, 0x89, 0x77, 0x30,
-	0x4c, 0x89, 0x7f, 0x38,
-	0x4c, 0x8b, 0x06,
-	0x48, 0x8b, 0x66, 0x08,
-	0x48, 0x8d, 0x64, 0x24, 0xf8,
-	0x48, 0x8b, 0x5e, 0x10,
-	0x48, 0x8b, 0x6e, 0x18,
-	0x4c, 0x8b, 0x66, 0x20,
-	0x4c, 0x8b, 0x6e, 0x28,
-	0x4c, 0x8b, 0x76, 0x30,
-	0x4c, 0x8b, 0x7e, 0x38,
-	0x48, 0x89, 0xd7,
-	0x41, 0x50,
-	0x31, 0xc0,
-	0xc3,
-#endif
-0x4c, 0x8b, 0x04, 0x24,
-0x4c, 0x89, 0x07,
-0x4c, 0x8d, 0x44, 0x24, 0x08,
-0x4c, 0x89, 0x47, 0x08,
-0x48, 0x89, 0x5f, 0x10,
-0x48, 0x89, 0x6f, 0x18,
-0x4c, 0x89, 0x67, 0x20,
-0x4c, 0x89, 0x6f, 0x28,
-0x4c, 0x89, 0x77, 0x30,
-0x4c, 0x89, 0x7f, 0x38,
-0x4c, 0x8b, 0x06,
-0x48, 0x8b, 0x66, 0x08,
-0x48, 0x8b, 0x5e, 0x10,
-0x48, 0x8b, 0x6e, 0x18,
-0x4c, 0x8b, 0x66, 0x20,
-0x4c, 0x8b, 0x6e, 0x28,
-0x4c, 0x8b, 0x76, 0x30,
-0x4c, 0x8b, 0x7e, 0x38,
-0x48, 0x89, 0xd7,
-0x41, 0x50,
-0x31, 0xc0,
-0xc3,
-};
-#endif
-
-__attribute__((section(".text")))
-static u8 GetSystemContextCode[] =
-{
-	0x4c, 0x8b, 0x04, 0x24,
-	0x4c, 0x89, 0x07,
-	0x4c, 0x8d, 0x44, 0x24, 0x08,
-	0x4c, 0x89, 0x47, 0x08,
-	0x48, 0x89, 0x5f, 0x10,
-	0x48, 0x89, 0x6f, 0x18,
-	0x4c, 0x89, 0x67, 0x20,
-	0x4c, 0x89, 0x6f, 0x28,
-	0x4c, 0x89, 0x77, 0x30,
-	0x4c, 0x89, 0x7f, 0x38,
-	0x31, 0xc0,
-	0xc3,
-};
-
-__attribute__((section(".text")))
-static u8 SetSystemContextCode[] =
-{
-	0x4c, 0x8b, 0x07,
-	0x48, 0x8b, 0x67, 0x08,
-	0x48, 0x8b, 0x5f, 0x10,
-	0x48, 0x8b, 0x6f, 0x18,
-	0x4c, 0x8b, 0x67, 0x20,
-	0x4c, 0x8b, 0x6f, 0x28,
-	0x4c, 0x8b, 0x77, 0x30,
-	0x4c, 0x8b, 0x7f, 0x38,
-	0x41, 0x50,
-	0x31, 0xc0,
-	0xc3,
-};
-
-__attribute__((section(".text")))
-static u8 SwapSystemContextCode[] =
-{
-	0x4c, 0x8b, 0x04, 0x24,
-	0x4c, 0x89, 0x07,
-	0x4c, 0x8d, 0x44, 0x24, 0x08,
-	0x4c, 0x89, 0x47, 0x08,
-	0x48, 0x89, 0x5f, 0x10,
-	0x48, 0x89, 0x6f, 0x18,
-	0x4c, 0x89, 0x67, 0x20,
-	0x4c, 0x89, 0x6f, 0x28,
-	0x4c, 0x89, 0x77, 0x30,
-	0x4c, 0x89, 0x7f, 0x38,
-	0x4c, 0x8b, 0x06,
-	0x48, 0x8b, 0x66, 0x08,
-	0x48, 0x8b, 0x5e, 0x10,
-	0x48, 0x8b, 0x6e, 0x18,
-	0x4c, 0x8b, 0x66, 0x20,
-	0x4c, 0x8b, 0x6e, 0x28,
-	0x4c, 0x8b, 0x76, 0x30,
-	0x4c, 0x8b, 0x7e, 0x38,
-	0x41, 0x50,
-	0x31, 0xc0,
-	0xc3,
-};
-
-__attribute__((section(".text")))
-static u8 StartSystemContextCode[] =
-{
-	0x4c, 0x8b, 0x04, 0x24,
-	0x4c, 0x89, 0x07,
-	0x4c, 0x8d, 0x44, 0x24, 0x08,
-	0x4c, 0x89, 0x47, 0x08,
-	0x48, 0x89, 0x5f, 0x10,
-	0x48, 0x89, 0x6f, 0x18,
-	0x4c, 0x89, 0x67, 0x20,
-	0x4c, 0x89, 0x6f, 0x28,
-	0x4c, 0x89, 0x77, 0x30,
-	0x4c, 0x89, 0x7f, 0x38,
-	0x4c, 0x8b, 0x06,
-	0x48, 0x8b, 0x66, 0x08,
-	0x48, 0x89, 0xd7,
-	0x41, 0x50,
-	0x31, 0xc0,
-	0xc3,
-};
-
-
-	static void (*GetSystemContext)(SystemContext *) = (void (*)(SystemContext *))GetSystemContextCode;
-	static void (*SetSystemContext)(SystemContext *) = (void (*)(SystemContext *))SetSystemContextCode;
-	static void (*SwapSystemContext)(SystemContext *, SystemContext *) = (void (*)(SystemContext *, SystemContext *))SwapSystemContextCode;
-	static void (*StartSystemContext)(SystemContext *, SystemContext *, void *) = (void (*)(SystemContext *, SystemContext *, void *))StartSystemContextCode;
-
-#if 0
-	// @TODO: NOT FIBER PROC
-	void RunPlatformContext(SystemContext *from, SystemContext *to, Procedure proc, void *param, void *stack, s64 stackSize)
-	{
-		auto s = (u8 *)stack;
-		// The stack grows down!
-		s += stackSize;
-  		// Make 128 byte scratch space for the Red Zone. This arithmetic will not unalign
-  		// our stack pointer because 128 is a multiple of 16. The Red Zone must also be
-  		// 16-byte aligned.
-  		s -= 128;
-		// Make some room for the parameter.
-		auto p = (DoRunPlatformContextParameter *)s;
-		s -= sizeof(DoRunPlatformContextParameter);
-		// Align stack pointer on 16-byte boundary, required for SysV and SSE.
-  		s = (u8*)((uintptr_t)s & -16L);
-  		// For some reason, SSE segfaults unless I move the stack pointer down by 8 bytes?
-  		// @TODO: WHY????????
-  		s -= 8;
-		//to->rip = proc;
-		to->rsp = s;
-		DoRunSystemContext(from, to, param);
-	}
-	
-	void SwapSystemContext(SystemContext *from, SystemContext *to)
-	{
-		auto s = (u8 *)stack;
-		// The stack grows down!
-		s += stackSize;
-  		// Make 128 byte scratch space for the Red Zone. This arithmetic will not unalign
-  		// our stack pointer because 128 is a multiple of 16. The Red Zone must also be
-  		// 16-byte aligned.
-  		s -= 128;
-		// Make some room for the parameter.
-		auto p = (DoRunPlatformContextParameter *)s;
-		s -= sizeof(DoRunPlatformContextParameter);
-		// Align stack pointer on 16-byte boundary, required for SysV and SSE.
-  		s = (u8*)((uintptr_t)s & -16L);
-  		// For some reason, SSE segfaults unless I move the stack pointer down by 8 bytes?
-  		// @TODO: WHY????????
-  		s -= 8;
-  		if (to->started)
-  		{
-  			DoSwapSystemContext(from, to);
-  		}
-  		else
-  		{
-  			to->started = true;
-  			from->started = true;
-			DoRunSystemContext(from, to, to->param);
-		}
-	}
-#endif
-	typedef void (*SystemContextProcedure)(void *);
-
-	struct RunSystemContextParameter
+		.text
+		.p2align 4
+		.globl SwapSystemContext
+		.hidden SwapSystemContext
+		.type SwapSystemContext, @function
+		SwapSystemContext:
+			pushq %rbp
+			pushq %rbx
+			pushq %r12
+			pushq %r13
+			pushq %r14
+			pushq %r15
+			subq $8, %rsp
+			stmxcsr (%rsp)
+			fnstcw 4(%rsp)
+			movq %rsp, (%rdi)
+			movq (%rsi), %rsp
+			ldmxcsr (%rsp)
+			fldcw 4(%rsp)
+			addq $8, %rsp
+			popq %r15
+			popq %r14
+			popq %r13
+			popq %r12
+			popq %rbx
+			popq %rbp
+			ret
+		.size SwapSystemContext, .-SwapSystemContext
+	)");
+
+	// The first switch to a new fiber returns here. NewSystemContext leaves the procedure, the parameter, and the entry point in the
+	// callee-saved registers.
+	__asm(R"(
+		.text
+		.p2align 4
+		.globl StartSystemContext
+		.hidden StartSystemContext
+		.type StartSystemContext, @function
+		StartSystemContext:
+			movq %r12, %rdi
+			movq %r13, %rsi
+			callq *%r14
+			ud2
+		.size StartSystemContext, .-StartSystemContext
+	)");
+
+	extern "C" void SwapSystemContext(SystemContext *from, SystemContext *to);
+	extern "C" void StartSystemContext();
+
+	// Mirrors the order SwapSystemContext pops things off of the stack.
+	struct InitialSystemContextFrame
 	{
-		SystemContextProcedure procedure;
-		void *parameter;
-		SystemContext *callingContext;
-		SystemContext *thisContext;
+		u32 mxcsr;
+		u16 x87ControlWord;
+		u16 padding;
+		void *r15, *r14, *r13, *r12, *rbx, *rbp;
+		void *returnAddress;
 	};
 
-	/*
-	void RunSystemContext(void *param)
-	{
-		auto p = (RunSystemContextParameter *)param;
-		// Save the parameters to the stack before swapping back to the calling context.
-		// Once we swap back, the param pointer will be invalid because we stored the parameters on the stack.
-		auto pr = p->procedure;
-		auto pm = p->parameter;
-		SwapSystemContext(p->thisContext, p->callingContext);
-		pr(pm);
-		pthread_exit(NULL);
-	}
-	*/
+	static_assert(sizeof(InitialSystemContextFrame) == 64);
 
-	void RunSystemContext(SystemContext *from, SystemContext *to, SystemContextProcedure proc, void *param)
+	void RunSystemContext(Procedure proc, void *param)
 	{
-		to->rip = (void *)proc;
-  		StartSystemContext(from, to, param);
+		proc(param);
+		pthread_exit(NULL);
 	}
 
-	SystemContext NewSystemContext(void *stack, s64 stackSize)
-	{
-		auto s = (u8 *)stack;
-		// The stack grows down!
-		s += stackSize;
-		// Align stack pointer on 16-byte boundary, required for SysV and SSE.
-  		s = (u8 *)((uintptr_t)s & -16L);
-  		// Make 128 byte scratch space for the Red Zone. This arithmetic will not unalign
-  		// our stack pointer because 128 is a multiple of 16. The Red Zone must also be
-  		// 16-byte aligned.
-  		s -= 128;
-  		// For some reason, SSE segfaults unless I move the stack pointer down by 8 bytes.
-  		// @TODO: Why????????
-  		s -= 8;
-  		return
-  		{
-  			.rsp = s,
-  		};
-	}
-	/*
-	SystemContext NewSystemContext(SystemContextProcedure proc, void *param, void *stack, s64 stackSize)
+	SystemContext NewSystemContext(u8 *stack, s64 stackSize, Procedure proc, void *param)
 	{
-		auto s = (u8 *)stack;
-		// The stack grows down!
-		s += stackSize;
-		// Align stack pointer on 16-byte boundary, required for SysV and SSE.
-  		s = (u8 *)((uintptr_t)s & -16L);
-  		// Make 128 byte scratch space for the Red Zone. This arithmetic will not unalign
-  		// our stack pointer because 128 is a multiple of 16. The Red Zone must also be
-  		// 16-byte aligned.
-  		s -= 128;
-  		// For some reason, SSE segfaults unless I move the stack pointer down by 8 bytes.
-  		// @TODO: Why????????
-  		s -= 8;
-  		auto to = SystemContext
-  		{
-  			.rip = (void *)RunSystemContext,
-  			.rsp = s,
-  		};
-  		auto from = SystemContext{};
-  		auto p = RunSystemContextParameter
-  		{
-  			.procedure = proc,
-  			.parameter = param,
-  			.callingContext = &from,
-  			.thisContext = &to,
-  		};
-  		StartSystemContext(&from, &to, &p);
-  		return to;
+		// The stack grows down! Align the top of the stack on a 16-byte boundary, required for SysV and SSE. When SwapSystemContext
+		// returns into StartSystemContext the stack pointer will be exactly at the aligned top, so the call it makes sees a correctly
+		// aligned stack.
+		auto top = (u8 *)((PointerInt)(stack + stackSize) & -16L);
+		auto f = (InitialSystemContextFrame *)(top - sizeof(InitialSystemContextFrame));
+		*f = InitialSystemContextFrame
+		{
+			// New fibers inherit the floating point environment of the thread that created them.
+			.mxcsr = _mm_getcsr(),
+			.r14 = (void *)RunSystemContext,
+			.r13 = param,
+			.r12 = (void *)proc,
+			.returnAddress = (void *)StartSystemContext,
+		};
+		__asm volatile("fnstcw %0" : "=m"(f->x87ControlWord));
+		return
+		{
+			.rsp = f,
+		};
 	}
-	*/
-
 #else
 	#error Fiber: context switching is not defined for this CPU architecture.
 #endif
+#endif
 
-Fiber *fs[4];
+ThreadLocal auto runningFiber = (Fiber *){};
 
-#include <stdio.h>
-Fiber **RunningFiberPointer()
+// Fibers move between threads, so the address of a thread local can't be kept across a switch. Keeping this out of line makes every caller
+// look the address up again on whatever thread it is running on now.
+__attribute__((noinline)) Fiber **RunningFiberPointer()
 {
-	//static ThreadLocal auto f = (Fiber *){};
-	//static auto fs = NewArray<Fiber *>(WorkerThreadCount());
-	auto i = ThreadIndex();
-	Assert(i >= 0 && i < 4);
-	//printf("%ld\n", i);
-	return &fs[i];
+	return &runningFiber;
 }
 
 Fiber *Current()
@@ -423,16 +139,7 @@ void SetRunningFiber(Fiber *f)
 	*RunningFiberPointer() = f;
 }
 
-struct RunParameter
-{
-	Procedure procedure;
-	void *parameter;
-	SystemContext *callingContext;
-	SystemContext *thisContext;
-};
-
-#if !NEW_FIBER
-#include <ucontext.h>
+#ifdef UContextFiberBuild
 struct FiberCreationInfo
 {
 	Procedure procedure;
@@ -454,39 +161,50 @@ void Run(void *p)
 	proc(param);
 	pthread_exit(NULL);
 }
-#else
-
-// @TODO: Move this somewhere else. x64 and maybe linux specific?
+#endif
 
-void Run(void *param)
+s64 DefaultStackSize()
 {
-	auto p = (RunParameter *)param;
-	// Save the parameters to the stack before swapping back to the calling context.
-	// Once we swap back, the param pointer will be invalid because we stored the parameters on the stack.
-	auto fiberProc = p->procedure;
-	auto fiberParam = p->parameter;
-	SwapSystemContext(p->thisContext, p->callingContext);
-	fiberProc(fiberParam);
-	pthread_exit(NULL);
+	return 100 * cpu::PageSize();
 }
 
-#endif
+// Reserves the stack and its guard page. MAP_NORESERVE keeps the stack from being charged against the commit limit, and the kernel only
+// backs a page with memory the first time the fiber touches it.
+u8 *ReserveStack(s64 stackSize)
+{
+	auto guardSize = StackGuardPageCount * cpu::PageSize();
+	auto mem = mmap(0, guardSize + stackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (mem == (void *)-1)
+	{
+		Abort("Fiber", "Failed to reserve fiber stack: %k.", PlatformError());
+	}
+	if (mprotect(mem, guardSize, PROT_NONE) == -1)
+	{
+		Abort("Fiber", "Failed to mprotect stack guard page: %k.", PlatformError());
+	}
+	return (u8 *)mem + guardSize;
+}
 
 Fiber New(Procedure proc, void *param)
 {
-#if !NEW_FIBER
+	return NewWithStackSize(proc, param, DefaultStackSize());
+}
+
+Fiber NewWithStackSize(Procedure proc, void *param, s64 stackSize)
+{
+	Assert(stackSize > 0 && stackSize % cpu::PageSize() == 0);
+#ifdef UContextFiberBuild
 	auto f = Fiber{};
 	f.contextAllocatorStack.SetAllocator(mem::GlobalHeap());
 	f.contextAllocator = mem::GlobalHeap();
+	#ifdef DevelopmentBuild
+		f.allocationTagStack.SetAllocator(mem::GlobalHeap());
+	#endif
+	f.stack = ReserveStack(stackSize);
+	f.stackSize = stackSize;
 	getcontext(&f.context);
-	auto stack = (u8 *)mem::PlatformAllocate(StackSize + (StackGuardPageCount * CPUPageSize()));
-	Assert(mem::AlignPointer(stack, CPUPageSize()) == stack);
-	if (mprotect(stack, (StackGuardPageCount * CPUPageSize()), PROT_NONE) == -1)
-	{
-		Abort("Fiber", "Failed to mprotect stack guard page: %k.", PlatformError());
-	}
-	f.context.uc_stack.ss_sp = stack + (StackGuardPageCount * CPUPageSize());
-	f.context.uc_stack.ss_size = StackSize;
+	f.context.uc_stack.ss_sp = f.stack;
+	f.context.uc_stack.ss_size = stackSize;
 	f.context.uc_link = 0;
 	auto tempContext = ucontext_t{};
 	auto fci = FiberCreationInfo
@@ -507,23 +225,14 @@ Fiber New(Procedure proc, void *param)
 	{
 		.contextAllocator = mem::GlobalHeap(),
 		.contextAllocatorStack = arr::NewIn<mem::Allocator *>(mem::GlobalHeap(), 0),
+		.stack = ReserveStack(stackSize),
+		.stackSize = stackSize,
 	};
-	auto stack = (u8 *)mem::PlatformAllocate(StackPlusGuardSize);
-	Assert(mem::AlignPointer(stack, CPUPageSize()) == stack);
-	if (mprotect(stack, (StackGuardPageCount * CPUPageSize()), PROT_NONE) == -1)
-	{
-		Abort("Fiber", "Failed to mprotect stack guard page: %k.", PlatformError());
-	}
-	f.context = NewSystemContext(stack, StackPlusGuardSize);
-	auto cc = SystemContext{};
-	auto p = RunParameter
-	{
-		.procedure = proc,
-		.parameter = param,
-		.callingContext = &cc,
-		.thisContext = &f.context,
-	};
-	RunSystemContext(&cc, &f.context, Run, &p);
+	#ifdef DevelopmentBuild
+		f.allocationTagStack.SetAllocator(mem::GlobalHeap());
+	#endif
+	// Nothing runs until the first Switch to the fiber.
+	f.context = NewSystemContext(f.stack, stackSize, proc, param);
 	#ifdef ThreadSanitizerBuild
 		f.tsan = __tsan_create_fiber(0);
 	#endif
@@ -535,6 +244,9 @@ void ConvertThread(Fiber *f)
 {
 	f->contextAllocatorStack.SetAllocator(mem::GlobalHeap());
 	f->contextAllocator = mem::GlobalHeap();
+	#ifdef DevelopmentBuild
+		f->allocationTagStack.SetAllocator(mem::GlobalHeap());
+	#endif
 	SetRunningFiber(f);
 	#ifdef ThreadSanitizerBuild
 		f->tsan = __tsan_create_fiber(0);
@@ -544,7 +256,7 @@ void ConvertThread(Fiber *f)
 // @TODO: Prevent two fibers from running at the same time.
 void Fiber::Switch()
 {
-#if !NEW_FIBER
+#ifdef UContextFiberBuild
 	if (!_setjmp(Current()->jumpBuffer))
 	{
 		#ifdef ThreadSanitizerBuild
@@ -555,68 +267,45 @@ void Fiber::Switch()
 	}
 #else
 	auto from = Current();
-	SetRunningFiber(this);
 	Assert(from);
-	Assert(this);
+	Assert(from != this);
+	SetRunningFiber(this);
+	#ifdef ThreadSanitizerBuild
+		__tsan_switch_to_fiber(this->tsan, 0);
+	#endif
 	SwapSystemContext(&from->context, &this->context);
-	#if 0
-	if (this->runParameters.running)
-	{
-		// This fiber is already running, just resume it's execution.
-	}
-	else
+#endif
+}
+
+// Returns the most stack the fiber has ever used, in bytes, rounded up to a page. The stack grows down and pages are only backed once they
+// are touched, so the lowest resident page marks the deepest the fiber has gone. Doesn't make sense for a converted thread.
+s64 Fiber::StackHighWaterMark()
+{
+	Assert(this->stack);
+	auto pageSize = cpu::PageSize();
+	auto pageCount = this->stackSize / pageSize;
+	u8 resident[64];
+	for (auto i = 0; i < pageCount; i += sizeof(resident))
 	{
-		this->runParameters.running = true;
-		//this->stack = fiberStackPool.Get();
-		//if (!this->stack)
-		if (true)
+		auto n = pageCount - i;
+		if (n > (s64)sizeof(resident))
 		{
-			this->stack = (u8 *)AllocatePlatformMemory(StackPlusGuardSize);
-			Assert(AlignPointer(this->stack, CPUPageSize()) == this->stack);
-			if (mprotect(this->stack, (StackGuardPageCount * CPUPageSize()), PROT_NONE) == -1)
-			{
-				Abort("Fiber", "Failed to mprotect stack guard page: %k.", PlatformError());
-			}
+			n = sizeof(resident);
 		}
-		RunPlatformContext(&from->context, &this->context, Run, &this->runParameters, this->stack, StackPlusGuardSize);
-	}
-	SetRunningFiber(from);
-	if (!this->runParameters.running)
-	{
-		//fiberStackPool.Release(this->stack);
-	}
-	#endif
-	/*
-	auto from = Current();
-	SetRunningFiber(this);
-	if (this->runParameters.running)
-	{
-		// This fiber is already running, just resume it's execution.
-		SwapSystemContext(&from->context, &this->context);
-	}
-	else
-	{
-		this->runParameters.running = true;
-		//this->stack = fiberStackPool.Get();
-		//if (!this->stack)
-		if (true)
+		if (mincore(this->stack + (i * pageSize), n * pageSize, resident) == -1)
+		{
+			log::Error("Fiber", "Failed to get fiber stack residency: %k.", PlatformError());
+			return this->stackSize;
+		}
+		for (auto j = 0; j < n; j += 1)
 		{
-			this->stack = (u8 *)AllocatePlatformMemory(StackPlusGuardSize);
-			Assert(AlignPointer(this->stack, CPUPageSize()) == this->stack);
-			if (mprotect(this->stack, (StackGuardPageCount * CPUPageSize()), PROT_NONE) == -1)
+			if (resident[j] & 1)
 			{
-				Abort("Fiber", "Failed to mprotect stack guard page: %k.", PlatformError());
+				return (pageCount - (i + j)) * pageSize;
 			}
 		}
-		RunPlatformContext(&from->context, &this->context, Run, &this->runParameters, this->stack, StackPlusGuardSize);
 	}
-	SetRunningFiber(from);
-	if (!this->runParameters.running)
-	{
-		//fiberStackPool.Release(this->stack);
-	}
-	*/
-#endif
+	return 0;
 }
 
 /*
@@ -5,26 +5,29 @@
 #include "Basic/Memory.h"
 #include "Common.h"
 
+// By default fibers are switched with a hand-written context switch that only saves the callee-saved registers. Define
+// UContextFiberBuild to fall back to the ucontext backend.
+#ifdef UContextFiberBuild
+	#include <ucontext.h>
+	#include <setjmp.h>
+#endif
+
 namespace fiber
 {
 
-	struct SystemContext
-	{
-		void *rip, *rsp;
-		void *rbx, *rbp, *r12, *r13, *r14, *r15;
-	};
-
-#define NEW_FIBER 1
-
-#if !NEW_FIBER
-#include <setjmp.h>
+#ifndef UContextFiberBuild
+// Everything else is saved on the fiber's own stack by SwapSystemContext.
+struct SystemContext
+{
+	void *rsp;
+};
 #endif
 
 typedef void (*Procedure)(void *);
 
 struct Fiber
 {
-#if !NEW_FIBER
+#ifdef UContextFiberBuild
 	ucontext_t context;
 	jmp_buf jumpBuffer;
 	mem::Allocator *contextAllocator;
@@ -34,15 +37,27 @@ struct Fiber
 	mem::Allocator *contextAllocator;
 	arr::array<mem::allocator *> contextAllocatorStack;
 #endif
+	#ifdef DevelopmentBuild
+		arr::array<const char *> allocationTagStack;
+	#endif
+	mem::ScratchArena scratchArena; // Goes with the fiber when it moves between threads.
+	u8 *stack; // The lowest usable address, just above the guard page.
+	s64 stackSize;
 	#ifdef ThreadSanitizerBuild
 		void *tsan;
 	#endif
 
 	void Switch();
+	s64 StackHighWaterMark();
 	void Delete();
 };
 
+// The stack size used by New. The address space is reserved when the fiber is created, but pages are only backed by memory once the
+// fiber touches them, so a large stack costs little until it is actually used.
+s64 DefaultStackSize();
+
 Fiber New(Procedure proc, void *param);
+Fiber NewWithStackSize(Procedure proc, void *param, s64 stackSize);
 void ConvertThread(Fiber *f);
 Fiber *Current();
 
@@ -3,3 +3,5 @@
 #include "../../../container/array/array.h"
 #include "../../../container/array/view.h"
 #include "../../../container/array/static.h"
+#include "../../../Container/Arr/virtual.h"
+#include "../../../Container/Arr/small.h"
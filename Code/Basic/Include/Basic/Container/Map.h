@@ -1,3 +1,4 @@
 #pragma once
 
 #include "../../../Container/Map/Map.h"
+#include "../../../Container/Map/ConcurrentMap.h"
@@ -6,5 +6,6 @@
 #include "../../Memory/Memory.h"
 #include "../../Memory/HeapAllocator.h"
 #include "../../Memory/PoolAllocator.h"
+#include "../../Memory/ScratchAllocator.h"
 #include "../../Memory/SlotAllocator.h"
 #include "../../Memory/StackAllocator.h"
@@ -33,6 +33,7 @@
 	#include <pthread.h>
 	#include <sys/syscall.h>
 	#include <sys/prctl.h>
+	#include <linux/futex.h>
 
 	// Semaphore
 	#include <semaphore.h>
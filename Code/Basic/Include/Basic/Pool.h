@@ -3,3 +3,4 @@
 #include "../../Container/Pool/Pool.h"
 #include "../../Container/Pool/Static.h"
 #include "../../Container/Pool/Frame.h"
+#include "../../Container/Pool/SlotMap.h"
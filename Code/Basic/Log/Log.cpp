@@ -42,6 +42,7 @@ void SetLevel(Level l)
 
 void ConsoleVarArgs(str::String fmt, va_list args)
 {
+	auto scratch = mem::ScratchScope{};
 	auto sb = str::Builder{};
 	sb.FormatVarArgs(fmt, args);
 	ConsoleWrite(sb.View(0, sb.Length()));
@@ -98,9 +99,10 @@ str::String LevelToString(Level l)
 void LogPrintVarArgs(str::String file, str::String func, s64 line, LogLevel lvl, str::String category, str::String fmt, va_list args)
 {
 	#if DebugBuild
-		auto msg = str::FormatVarArgs(fmt, args);
 		// We need to be a bit careful about not allocating memory, because this might be called using
-		// the fixed-size backup allocator.
+		// the fixed-size backup allocator. Everything here is temporary, so it all comes from the scratch arena.
+		auto scratch = mem::ScratchScope{};
+		auto msg = str::FormatVarArgs(fmt, args);
 		if (l >= CurrentLogLevel())
 		{
 			ConsoleWrite("[");
@@ -9,6 +9,9 @@ struct AllocationHeader
 {
 	s64 size;
 	s64 alignment;
+	#ifdef DevelopmentBuild
+		s64 site; // Index into the allocator's AllocationTracker.
+	#endif
 };
 
 u8 *SetAllocationHeaderAndData(void *mem, s64 size, s64 align);
@@ -0,0 +1,271 @@
+#include "AllocationTracker.h"
+#include "ContextAllocator.h"
+#include "Memory.h"
+#include "../Log.h"
+#include "../PCH.h"
+#include <stdio.h>
+
+namespace mem
+{
+
+#ifdef DevelopmentBuild
+
+auto allocationTrackers = (AllocationTracker *){};
+auto allocationTrackersLock = Spinlock{};
+
+void RegisterAllocationTracker(AllocationTracker *t, const char *name)
+{
+	t->name = name;
+	allocationTrackersLock.Lock();
+	Defer(allocationTrackersLock.Unlock());
+	t->next = allocationTrackers;
+	allocationTrackers = t;
+}
+
+s64 AllocationSite(AllocationTracker *t, const char *tag, void *callsite)
+{
+	const auto maxProbeCount = 16;
+	auto hash = (((u64)tag * 31) + (u64)callsite) * 0x9E3779B97F4A7C15ull;
+	auto i = (s64)(hash >> 32);
+	for (auto j = 0; j < maxProbeCount; j += 1, i += 1)
+	{
+		auto s = i & (AllocationSiteCount - 1);
+		if (s == 0)
+		{
+			continue;
+		}
+		auto site = &t->sites[s];
+		if (site->allocationCount == 0)
+		{
+			site->tag = tag;
+			site->callsite = callsite;
+			return s;
+		}
+		if (site->tag == tag && site->callsite == callsite)
+		{
+			return s;
+		}
+	}
+	return 0;
+}
+
+s64 AllocationHistogramBucket(s64 size)
+{
+	auto b = 63 - __builtin_clzll(size | 1);
+	return (b < AllocationHistogramBucketCount) ? b : AllocationHistogramBucketCount - 1;
+}
+
+void AllocationTracker::Allocate(AllocationHeader *h, void *callsite)
+{
+	auto tag = AllocationTag();
+	this->lock.Lock();
+	Defer(this->lock.Unlock());
+	h->site = AllocationSite(this, tag, callsite);
+	auto s = &this->sites[h->site];
+	s->liveBytes += h->size;
+	s->liveCount += 1;
+	s->allocationCount += 1;
+	s->peakBytes = (s->liveBytes > s->peakBytes) ? s->liveBytes : s->peakBytes;
+	this->total.liveBytes += h->size;
+	this->total.liveCount += 1;
+	this->total.allocationCount += 1;
+	this->total.peakBytes = (this->total.liveBytes > this->total.peakBytes) ? this->total.liveBytes : this->total.peakBytes;
+	this->total.sizeHistogram[AllocationHistogramBucket(h->size)] += 1;
+}
+
+// Called after the allocation has been resized in place, so the memory stays with the site that allocated it.
+void AllocationTracker::Resize(AllocationHeader *h, s64 oldSize)
+{
+	this->lock.Lock();
+	Defer(this->lock.Unlock());
+	auto s = &this->sites[h->site];
+	s->liveBytes += h->size - oldSize;
+	s->peakBytes = (s->liveBytes > s->peakBytes) ? s->liveBytes : s->peakBytes;
+	this->total.liveBytes += h->size - oldSize;
+	this->total.peakBytes = (this->total.liveBytes > this->total.peakBytes) ? this->total.liveBytes : this->total.peakBytes;
+}
+
+void AllocationTracker::Deallocate(AllocationHeader *h)
+{
+	this->lock.Lock();
+	Defer(this->lock.Unlock());
+	auto s = &this->sites[h->site];
+	s->liveBytes -= h->size;
+	s->liveCount -= 1;
+	this->total.liveBytes -= h->size;
+	this->total.liveCount -= 1;
+}
+
+// For allocators that free everything at once.
+void AllocationTracker::Clear()
+{
+	this->lock.Lock();
+	Defer(this->lock.Unlock());
+	for (auto &s : this->sites)
+	{
+		s.liveBytes = 0;
+		s.liveCount = 0;
+	}
+	this->total.liveBytes = 0;
+	this->total.liveCount = 0;
+}
+
+AllocationStatistics AllocatorStatistics(AllocationTracker *t)
+{
+	t->lock.Lock();
+	Defer(t->lock.Unlock());
+	return t->total;
+}
+
+// Sums the tag's statistics over all of its callsites. Each callsite peaked at its own time, so the peak is an upper bound.
+AllocationSiteStatistics AllocationTagStatistics(AllocationTracker *t, const char *tag)
+{
+	t->lock.Lock();
+	Defer(t->lock.Unlock());
+	auto r = AllocationSiteStatistics
+	{
+		.tag = tag,
+	};
+	for (auto s : t->sites)
+	{
+		if (s.allocationCount > 0 && s.tag == tag)
+		{
+			r.liveBytes += s.liveBytes;
+			r.peakBytes += s.peakBytes;
+			r.liveCount += s.liveCount;
+			r.allocationCount += s.allocationCount;
+		}
+	}
+	return r;
+}
+
+// Logging allocates, so the statistics are copied out before anything is printed. The copy comes straight from the OS so that it doesn't
+// show up in the statistics itself.
+AllocationTracker *SnapshotAllocationTracker(AllocationTracker *t)
+{
+	auto s = (AllocationTracker *)PlatformAllocate(sizeof(AllocationTracker));
+	t->lock.Lock();
+	Defer(t->lock.Unlock());
+	s->name = t->name;
+	s->total = t->total;
+	s->sites = t->sites;
+	return s;
+}
+
+const char *AllocationTagName(const char *tag)
+{
+	return tag ? tag : "Untagged";
+}
+
+const char *AllocationCallsiteName(void *callsite, char *buffer, s64 bufferSize)
+{
+	auto info = Dl_info{};
+	if (callsite && dladdr(callsite, &info) && info.dli_sname)
+	{
+		return info.dli_sname;
+	}
+	snprintf(buffer, bufferSize, "%p", callsite);
+	return buffer;
+}
+
+void LogAllocationStatistics()
+{
+	for (auto t = allocationTrackers; t; t = t->next)
+	{
+		auto s = SnapshotAllocationTracker(t);
+		Defer(PlatformDeallocate(s, sizeof(AllocationTracker)));
+		log::Info("Memory", "%s: %d live bytes in %d allocations, %d peak bytes, %d allocations in total.", s->name, s->total.liveBytes, s->total.liveCount, s->total.peakBytes, s->total.allocationCount);
+		for (auto i = 0; i < AllocationHistogramBucketCount; i += 1)
+		{
+			if (s->total.sizeHistogram[i] > 0)
+			{
+				log::Info("Memory", "	%d+ bytes: %d allocations", 1ll << i, s->total.sizeHistogram[i]);
+			}
+		}
+		for (auto i = 0; i < AllocationSiteCount; i += 1)
+		{
+			auto first = &s->sites[i];
+			if (first->allocationCount == 0 || first->callsite == (void *)-1)
+			{
+				continue;
+			}
+			// Print each tag once, followed by its callsites. Sites that have been printed are marked by their callsite.
+			auto tag = AllocationSiteStatistics
+			{
+				.tag = first->tag,
+			};
+			for (auto j = i; j < AllocationSiteCount; j += 1)
+			{
+				auto site = &s->sites[j];
+				if (site->allocationCount > 0 && site->tag == first->tag)
+				{
+					tag.liveBytes += site->liveBytes;
+					tag.liveCount += site->liveCount;
+					tag.allocationCount += site->allocationCount;
+				}
+			}
+			log::Info("Memory", "	%s: %d live bytes in %d allocations, %d allocations in total.", AllocationTagName(tag.tag), tag.liveBytes, tag.liveCount, tag.allocationCount);
+			for (auto j = i; j < AllocationSiteCount; j += 1)
+			{
+				auto site = &s->sites[j];
+				if (site->allocationCount > 0 && site->tag == first->tag && site->callsite != (void *)-1)
+				{
+					char buffer[32];
+					log::Info("Memory", "		%s: %d live bytes in %d allocations, %d peak bytes, %d allocations in total.", AllocationCallsiteName(site->callsite, buffer, sizeof(buffer)), site->liveBytes, site->liveCount, site->peakBytes, site->allocationCount);
+					site->callsite = (void *)-1;
+				}
+			}
+		}
+	}
+}
+
+// Meant to be called right before the process exits. Anything still allocated is reported, grouped by tag and callsite.
+void LogAllocationLeaks()
+{
+	for (auto t = allocationTrackers; t; t = t->next)
+	{
+		auto s = SnapshotAllocationTracker(t);
+		Defer(PlatformDeallocate(s, sizeof(AllocationTracker)));
+		if (s->total.liveCount == 0)
+		{
+			continue;
+		}
+		log::Info("Memory", "%s: %d bytes in %d allocations were never freed.", s->name, s->total.liveBytes, s->total.liveCount);
+		for (auto &site : s->sites)
+		{
+			if (site.liveCount > 0)
+			{
+				char buffer[32];
+				log::Info("Memory", "	%s, %s: %d bytes in %d allocations.", AllocationTagName(site.tag), AllocationCallsiteName(site.callsite, buffer, sizeof(buffer)), site.liveBytes, site.liveCount);
+			}
+		}
+	}
+}
+
+#else
+
+void RegisterAllocationTracker(AllocationTracker *t, const char *name)
+{
+}
+
+AllocationStatistics AllocatorStatistics(AllocationTracker *t)
+{
+	return {};
+}
+
+AllocationSiteStatistics AllocationTagStatistics(AllocationTracker *t, const char *tag)
+{
+	return {};
+}
+
+void LogAllocationStatistics()
+{
+}
+
+void LogAllocationLeaks()
+{
+}
+
+#endif
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "AllocationHeader.h"
+#include "Basic/Thread.h"
+#include "Basic/Container/Array.h"
+
+namespace mem
+{
+
+// Counts where an allocator's memory goes, by allocation tag and callsite. Tags come from the context allocator stack (see
+// PushAllocationTag) and callsites are return addresses, resolved to symbol names when the statistics are logged.
+//
+// Tracking only exists in development builds. In release builds the allocators don't touch a tracker and the allocation header doesn't
+// have a site.
+
+const auto AllocationSiteCount = 1024; // Must be a power of two.
+const auto AllocationHistogramBucketCount = 32; // Bucket i counts sizes in [2^i, 2^(i+1)). The last bucket also counts everything bigger.
+
+struct AllocationSiteStatistics
+{
+	const char *tag;
+	void *callsite;
+	s64 liveBytes;
+	s64 peakBytes;
+	s64 liveCount;
+	s64 allocationCount;
+};
+
+struct AllocationStatistics
+{
+	s64 liveBytes;
+	s64 peakBytes;
+	s64 liveCount;
+	s64 allocationCount;
+	arr::Static<s64, AllocationHistogramBucketCount> sizeHistogram; // Every allocation ever made, by its size.
+};
+
+struct AllocationTracker
+{
+	const char *name;
+	Spinlock lock;
+	AllocationStatistics total;
+	// Open addressed on the tag and callsite. Site 0 is never hashed to, it collects whatever doesn't fit in the table.
+	arr::Static<AllocationSiteStatistics, AllocationSiteCount> sites;
+	AllocationTracker *next;
+
+	void Allocate(AllocationHeader *h, void *callsite);
+	void Resize(AllocationHeader *h, s64 oldSize);
+	void Deallocate(AllocationHeader *h);
+	void Clear();
+};
+
+#ifdef DevelopmentBuild
+	#define AllocationCallsite() __builtin_return_address(0)
+#else
+	#define AllocationCallsite() NULL
+#endif
+
+void RegisterAllocationTracker(AllocationTracker *t, const char *name);
+AllocationStatistics AllocatorStatistics(AllocationTracker *t);
+AllocationSiteStatistics AllocationTagStatistics(AllocationTracker *t, const char *tag);
+void LogAllocationStatistics();
+void LogAllocationLeaks();
+
+}
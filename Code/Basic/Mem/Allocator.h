@@ -10,6 +10,8 @@ struct Allocator
 	virtual void *Allocate(s64 size) = 0;
 	virtual void *AllocateAligned(s64 size, s64 align) = 0;
 	virtual void *Resize(void *mem, s64 size) = 0;
+	// Grows or shrinks an allocation without moving it. Returns false, leaving the allocation untouched, if it can't be done.
+	virtual bool ResizeInPlace(void *mem, s64 newSize) = 0;
 	virtual void Deallocate(void *mem) = 0;
 	virtual void Clear() = 0;
 	virtual void Free() = 0;
@@ -1,4 +1,6 @@
 #include "AllocatorBlocks.h"
+#include "Memory.h"
+#include "Basic/CPU.h"
 
 namespace mem
 {
@@ -19,6 +21,29 @@ BlockAllocator NewBlockAllocator(s64 blockSize, s64 blockCount, Allocator *block
 	return b;
 }
 
+// Returns the used block that mem points into, or NULL.
+u8 *BlockAllocator::FindBlock(void *mem)
+{
+	for (auto b : this->used)
+	{
+		if ((u8 *)mem >= b && (u8 *)mem < b + this->blockSize)
+		{
+			return b;
+		}
+	}
+	return NULL;
+}
+
+// The granularity a block can be decommitted at.
+s64 BlockAllocator::BlockPageSize(void *block)
+{
+	if (!this->pageStrategy)
+	{
+		return CPUPageSize();
+	}
+	return PageStrategySize(this->pageStrategy(this->allocator, block));
+}
+
 void BlockAllocator::AddBlock()
 {
 	Assert(this->blockSize > 0);
@@ -52,7 +77,21 @@ void *BlockAllocator::AllocateWithHeader(s64 size, s64 align)
 	auto maxSize = size + sizeof(AllocationHeader) + (alignof(AllocationHeader) - 1) + align;
 	Assert(maxSize <= this->blockSize);
 	auto mem = this->Allocate(size + sizeof(AllocationHeader) + align, alignof(AllocationHeader));
-	return SetAllocationHeaderAndData(mem, size, align);
+	auto dat = SetAllocationHeaderAndData(mem, size, align);
+	// Give back the alignment padding we didn't need, so the allocation ends right at the frontier and can be resized in place.
+	this->frontier = dat + size;
+	return dat;
+}
+
+// Grows or shrinks the most recent allocation by moving the frontier.
+bool BlockAllocator::ResizeInPlace(void *mem, s64 size, s64 newSize)
+{
+	if (!this->frontier || (u8 *)mem + size != this->frontier || (u8 *)mem + newSize > this->end)
+	{
+		return false;
+	}
+	this->frontier = (u8 *)mem + newSize;
+	return true;
 }
 
 void BlockAllocator::Clear()
@@ -65,9 +104,35 @@ void BlockAllocator::Clear()
 	}
 }
 
+// Decommits the unused blocks and whatever is left of the current block. They stay reserved, and are committed again when they're touched.
+s64 BlockAllocator::Trim()
+{
+	auto n = s64{};
+	for (auto b : this->unused)
+	{
+		n += DecommitPages(b, b + this->blockSize, this->BlockPageSize(b));
+	}
+	if (this->frontier)
+	{
+		n += DecommitPages(this->frontier, this->end, this->BlockPageSize(*this->used.Last()));
+	}
+	return n;
+}
+
 void BlockAllocator::Free()
 {
-	// @TODO
+	for (auto b : this->used)
+	{
+		this->allocator->Deallocate(b);
+	}
+	for (auto b : this->unused)
+	{
+		this->allocator->Deallocate(b);
+	}
+	this->used.Free();
+	this->unused.Free();
+	this->frontier = NULL;
+	this->end = NULL;
 }
 
 }
@@ -1,22 +1,31 @@
 #pragma once
 
+#include "Memory.h"
 #include "Basic/Container/Array.h"
 
 namespace mem
 {
 
+// Says what kind of pages the block allocator backed a block with.
+typedef PlatformPageStrategy (*BlockPageStrategyProcedure)(Allocator *blockAlloc, void *block);
+
 struct BlockAllocator
 {
 	s64 blockSize;
 	Allocator *allocator;
+	BlockPageStrategyProcedure pageStrategy; // NULL if every block has small pages.
 	arr::array<u8 *> used;
 	arr::array<u8 *> unused;
 	u8 *frontier;
 	u8 *end;
 
+	u8 *FindBlock(void *mem);
+	s64 BlockPageSize(void *block);
 	void AddBlock();
 	void *Allocate(s64 size, s64 align);
 	void *AllocateWithHeader(s64 size, s64 align);
+	bool ResizeInPlace(void *mem, s64 size, s64 newSize);
+	s64 Trim();
 	void Clear();
 	void Free();
 };
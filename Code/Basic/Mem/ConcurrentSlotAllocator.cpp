@@ -0,0 +1,202 @@
+#include "ConcurrentSlotAllocator.h"
+#include "Basic/Atomic.h"
+
+namespace mem
+{
+
+// User space addresses fit in the low 48 bits, which leaves the top 16 bits of the shared list head for the tag.
+const auto SlotTagShift = 48;
+const auto SlotPointerMask = (1ull << SlotTagShift) - 1;
+
+void *SlotPointer(s64 tagged)
+{
+	return (void *)((u64)tagged & SlotPointerMask);
+}
+
+s64 NextSlotTaggedPointer(s64 tagged, void *p)
+{
+	auto tag = ((u64)tagged >> SlotTagShift) + 1;
+	return (s64)((tag << SlotTagShift) | (u64)p);
+}
+
+ConcurrentSlotAllocator NewConcurrentSlotAllocator(s64 slotSize, s64 slotAlign, s64 slotCount, s64 slotsPerBlock, Allocator *blockAlloc, Allocator *arrayAlloc)
+{
+	Assert(slotSize >= sizeof(void *));
+	auto nBlks = (slotCount + (slotsPerBlock - 1)) / slotsPerBlock; // Divide and round up.
+	auto a = ConcurrentSlotAllocator{};
+	a.blocks = NewBlockAllocator(slotsPerBlock * slotSize, nBlks, blockAlloc, arrayAlloc);
+	a.slotSize = slotSize;
+	a.slotAlignment = slotAlign;
+	return a;
+}
+
+// Pushes a chain of free slots, already linked from first to last, onto the shared list.
+void PushSharedSlots(ConcurrentSlotAllocator *a, void *first, void *last)
+{
+	auto head = a->freeSlots;
+	while (true)
+	{
+		*(void **)last = SlotPointer(head);
+		auto old = AtomicCompareAndSwap64(&a->freeSlots, head, NextSlotTaggedPointer(head, first));
+		if (old == head)
+		{
+			return;
+		}
+		head = old;
+	}
+}
+
+void *PopSharedSlot(ConcurrentSlotAllocator *a)
+{
+	auto head = a->freeSlots;
+	while (true)
+	{
+		auto s = SlotPointer(head);
+		if (!s)
+		{
+			return NULL;
+		}
+		// Another thread may have popped the slot and started using it since we read the head, so this can read garbage. Slots are never
+		// unmapped, so the read is safe, and the tag will have changed, so the swap fails and we try again.
+		auto next = *(void *volatile *)s;
+		auto old = AtomicCompareAndSwap64(&a->freeSlots, head, NextSlotTaggedPointer(head, next));
+		if (old == head)
+		{
+			return s;
+		}
+		head = old;
+	}
+}
+
+void *NewSlot(ConcurrentSlotAllocator *a)
+{
+	return a->blocks.Allocate(a->slotSize, a->slotAlignment);
+}
+
+// Takes a batch from the shared list, or carves a new batch out of the blocks if the shared list is empty.
+void RefillSlotCache(ConcurrentSlotAllocator *a, ConcurrentSlotCache *c)
+{
+	while (c->count < ConcurrentSlotBatchSize)
+	{
+		auto s = PopSharedSlot(a);
+		if (!s)
+		{
+			break;
+		}
+		*(void **)s = c->slots;
+		c->slots = s;
+		c->count += 1;
+	}
+	if (c->count > 0)
+	{
+		return;
+	}
+	a->blocksLock.Lock();
+	Defer(a->blocksLock.Unlock());
+	for (auto i = 0; i < ConcurrentSlotBatchSize; i += 1)
+	{
+		auto s = NewSlot(a);
+		*(void **)s = c->slots;
+		c->slots = s;
+		c->count += 1;
+	}
+}
+
+// A job can move to another worker while it is suspended, but not in the middle of an allocation, so the cache of the thread we are on
+// can't be touched by anyone else until we return.
+ConcurrentSlotCache *SlotCache(ConcurrentSlotAllocator *a)
+{
+	auto i = ThreadIndex();
+	if (i >= ConcurrentSlotCacheCount)
+	{
+		return NULL;
+	}
+	return &a->caches[i];
+}
+
+void *ConcurrentSlotAllocator::Allocate(s64 size)
+{
+	Assert(size == this->slotSize);
+	auto c = SlotCache(this);
+	if (!c)
+	{
+		if (auto s = PopSharedSlot(this); s)
+		{
+			return s;
+		}
+		this->blocksLock.Lock();
+		Defer(this->blocksLock.Unlock());
+		return NewSlot(this);
+	}
+	if (c->count == 0)
+	{
+		RefillSlotCache(this, c);
+	}
+	auto s = c->slots;
+	c->slots = *(void **)s;
+	c->count -= 1;
+	return s;
+}
+
+void *ConcurrentSlotAllocator::AllocateAligned(s64 size, s64 align)
+{
+	return this->Allocate(size);
+}
+
+void *ConcurrentSlotAllocator::Resize(void *mem, s64 newSize)
+{
+	Abort("Memory", "Attempted to resize a slot memory allocation.");
+	return NULL;
+}
+
+bool ConcurrentSlotAllocator::ResizeInPlace(void *mem, s64 newSize)
+{
+	return newSize <= this->slotSize;
+}
+
+void ConcurrentSlotAllocator::Deallocate(void *mem)
+{
+	auto c = SlotCache(this);
+	if (!c)
+	{
+		PushSharedSlots(this, mem, mem);
+		return;
+	}
+	*(void **)mem = c->slots;
+	c->slots = mem;
+	c->count += 1;
+	// Keep a batch around after giving one back, so a thread that allocates and frees around the limit doesn't hit the shared list every
+	// time.
+	if (c->count < 2 * ConcurrentSlotBatchSize)
+	{
+		return;
+	}
+	auto first = c->slots;
+	auto last = first;
+	for (auto i = 1; i < ConcurrentSlotBatchSize; i += 1)
+	{
+		last = *(void **)last;
+	}
+	c->slots = *(void **)last;
+	c->count -= ConcurrentSlotBatchSize;
+	PushSharedSlots(this, first, last);
+}
+
+void ConcurrentSlotAllocator::Clear()
+{
+	this->blocks.Clear();
+	this->freeSlots = 0;
+	for (auto &c : this->caches)
+	{
+		c.slots = NULL;
+		c.count = 0;
+	}
+}
+
+void ConcurrentSlotAllocator::Free()
+{
+	this->Clear();
+	this->blocks.Free();
+}
+
+}
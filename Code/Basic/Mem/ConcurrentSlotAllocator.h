@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Allocator.h"
+#include "AllocatorBlocks.h"
+#include "Basic/Thread.h"
+#include "Basic/CPU.h"
+
+namespace mem
+{
+
+// A slot allocator that any thread can allocate from and free to without taking a lock.
+//
+// Free slots are linked through their own memory. Each thread keeps a small list of free slots that only it touches, and moves them to
+// and from a shared lock-free list in batches. The head of the shared list carries a tag in its top bits that changes on every update, so
+// a pop that raced with another pop and push of the same slot (ABA) fails its compare and swap instead of corrupting the list. Only
+// carving new slots out of a block takes a lock.
+//
+// Clear and Free must not race with anything else.
+
+const auto ConcurrentSlotCacheCount = 64; // Threads with a higher ThreadIndex skip the caches and only use the shared list.
+const auto ConcurrentSlotBatchSize = 32; // How many slots move between a thread's cache and the shared list at once.
+
+struct ConcurrentSlotCache
+{
+	void *slots;
+	s64 count;
+	u8 padding[CPUCacheLineSize - sizeof(void *) - sizeof(s64)];
+};
+
+struct ConcurrentSlotAllocator : Allocator
+{
+	s64 slotSize;
+	s64 slotAlignment;
+	volatile s64 freeSlots; // Tagged pointer to the shared list.
+	u8 freeSlotsPadding[CPUCacheLineSize - sizeof(s64)];
+	arr::Static<ConcurrentSlotCache, ConcurrentSlotCacheCount> caches;
+	Spinlock blocksLock;
+	BlockAllocator blocks;
+
+	void *Allocate(s64 size);
+	void *AllocateAligned(s64 size, s64 align);
+	void *Resize(void *mem, s64 newSize);
+	bool ResizeInPlace(void *mem, s64 newSize);
+	void Deallocate(void *mem);
+	void Clear();
+	void Free();
+};
+
+ConcurrentSlotAllocator NewConcurrentSlotAllocator(s64 slotSize, s64 slotAlignment, s64 slotCount, s64 slotsPerBlock, Allocator *blockAlloc, Allocator *arrayAlloc);
+
+}
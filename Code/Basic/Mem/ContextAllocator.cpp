@@ -8,6 +8,9 @@ namespace mem
 // We want these variables to have constant initialization so other global variable initializers can use the context allocator.
 ThreadLocal auto contextAllocator = (Allocator *){};
 ThreadLocal auto contextAllocatorStack = arr::array<Allocator *>{};
+#ifdef DevelopmentBuild
+	ThreadLocal auto allocationTagStack = arr::array<const char *>{};
+#endif
 
 Allocator *ContextAllocator()
 {
@@ -64,4 +67,48 @@ void PopContextAllocator()
 	}
 }
 
+#ifdef DevelopmentBuild
+
+arr::array<const char *> *AllocationTagStack()
+{
+	if (RunningFiber())
+	{
+		return &RunningFiber()->allocationTagStack;
+	}
+	if (!allocationTagStack.allocator)
+	{
+		// Don't let the tags end up in whatever the context allocator happens to be.
+		allocationTagStack.SetAllocator(GlobalHeap());
+	}
+	return &allocationTagStack;
+}
+
+void PushAllocationTag(const char *tag)
+{
+	AllocationTagStack()->Append(tag);
+}
+
+void PopAllocationTag()
+{
+	auto stk = AllocationTagStack();
+	if (stk->count == 0)
+	{
+		log::Error("Memory", "Tried to pop an empty allocation tag stack.\n");
+		return;
+	}
+	stk->Pop();
+}
+
+const char *AllocationTag()
+{
+	auto stk = AllocationTagStack();
+	if (stk->count == 0)
+	{
+		return NULL;
+	}
+	return *stk->Last();
+}
+
+#endif
+
 }
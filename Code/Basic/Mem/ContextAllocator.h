@@ -9,4 +9,16 @@ void PushContextAllocator(Allocator *a);
 void PopContextAllocator();
 Allocator *ContextAllocator();
 
+// Allocation tags label memory in the allocation statistics. Like the context allocator, the tag stack belongs to the running fiber. In
+// release builds tags are thrown away.
+#ifdef DevelopmentBuild
+	void PushAllocationTag(const char *tag);
+	void PopAllocationTag();
+	const char *AllocationTag();
+#else
+	inline void PushAllocationTag(const char *tag) {}
+	inline void PopAllocationTag() {}
+	inline const char *AllocationTag() { return NULL; }
+#endif
+
 }
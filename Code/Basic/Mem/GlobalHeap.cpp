@@ -6,11 +6,21 @@ namespace mem
 
 const auto GlobalHeapBlockSize = 64 * Megabyte;
 
+struct GlobalHeapBlock
+{
+	u8 *memory;
+	PlatformPageStrategy pages;
+};
+
 struct GlobalHeapBlockAllocator : allocator
 {
+	arr::Static<s64, PlatformPageStrategyCount> pageStrategyCounts; // Guarded by the global heap lock.
+	arr::array<GlobalHeapBlock> blocks; // Guarded by the global heap lock.
+
 	void *Allocate(s64 size);
 	void *AllocateAligned(s64 size, s64 align);
 	void *Resize(void *mem, s64 size);
+	bool ResizeInPlace(void *mem, s64 newSize);
 	void Deallocate(void *mem);
 	void Clear();
 	void Free();
@@ -20,7 +30,29 @@ void *GlobalHeapBlockAllocator::Allocate(s64 size)
 {
 	Assert(size == GlobalHeapBlockSize);
 	Assert(size % CPUPageSize() == 0);
-	return PlatformAllocate(size);
+	auto s = PlatformPageStrategy{};
+	auto mem = PlatformAllocateWithFlags(size, PlatformAllocateHugePages, &s);
+	this->pageStrategyCounts[s] += 1;
+	this->blocks.Append(
+	{
+		.memory = (u8 *)mem,
+		.pages = s,
+	});
+	return mem;
+}
+
+// Trimming needs to know which blocks got huge pages, so it only decommits whole huge pages in those.
+PlatformPageStrategy GlobalHeapBlockPageStrategy(Allocator *a, void *block)
+{
+	for (auto b : ((GlobalHeapBlockAllocator *)a)->blocks)
+	{
+		if (b.memory == block)
+		{
+			return b.pages;
+		}
+	}
+	Abort("Memory", "Tried to get the page strategy of an unknown global heap block.");
+	return PlatformSmallPages;
 }
 
 void *GlobalHeapBlockAllocator::AllocateAligned(s64 size, s64 align)
@@ -35,8 +67,24 @@ void *GlobalHeapBlockAllocator::Resize(void *mem, s64 newSize)
 	return NULL;
 }
 
+bool GlobalHeapBlockAllocator::ResizeInPlace(void *mem, s64 newSize)
+{
+	Abort("Memory", "Unsupported call to ResizeInPlace in GlobalHeapBlockAllocator.");
+	return false;
+}
+
 void GlobalHeapBlockAllocator::Deallocate(void *mem)
 {
+	for (auto i = 0; i < this->blocks.count; i += 1)
+	{
+		if (this->blocks[i].memory == mem)
+		{
+			this->pageStrategyCounts[this->blocks[i].pages] -= 1;
+			this->blocks[i] = *this->blocks.Last();
+			this->blocks.Pop();
+			break;
+		}
+	}
 	PlatformDeallocate(mem, GlobalHeapBlockSize);
 }
 
@@ -55,6 +103,7 @@ struct GlobalHeapArrayAllocator : allocator
 	void *Allocate(s64 size);
 	void *AllocateAligned(s64 size, s64 align);
 	void *Resize(void *mem, s64 newSize);
+	bool ResizeInPlace(void *mem, s64 newSize);
 	void Deallocate(void *mem);
 	void Clear();
 	void Free();
@@ -79,13 +128,29 @@ void *GlobalHeapArrayAllocator::AllocateAligned(s64 size, s64 align)
 
 void *GlobalHeapArrayAllocator::Resize(void *mem, s64 newSize)
 {
-	mem = (u8 *)mem - sizeof(s64);
-	auto size = *(s64 *)mem;
+	if (this->ResizeInPlace(mem, newSize))
+	{
+		return mem;
+	}
+	auto size = *(s64 *)((u8 *)mem - sizeof(s64));
+	auto n = size - (s64)sizeof(s64);
+	if (n > newSize)
+	{
+		n = newSize;
+	}
 	auto newMem = this->Allocate(newSize);
-	PlatformDeallocate(mem, size);
+	arr::Copy(arr::NewView((u8 *)mem, n), arr::NewView((u8 *)newMem, n));
+	this->Deallocate(mem);
 	return newMem;
 }
 
+bool GlobalHeapArrayAllocator::ResizeInPlace(void *mem, s64 newSize)
+{
+	// Allocations are rounded up to a whole number of pages, so there is usually room left at the end.
+	auto size = *(s64 *)((u8 *)mem - sizeof(s64));
+	return newSize + (s64)sizeof(s64) <= size;
+}
+
 void GlobalHeapArrayAllocator::Deallocate(void *mem)
 {
 	mem = (u8 *)mem - sizeof(s64);
@@ -103,30 +168,109 @@ void GlobalHeapArrayAllocator::Free()
 	Abort("Memory", "Unsupported call to Free in GlobalHeapArrayAllocator.");
 }
 
-void *GlobalHeapAllocator::Allocate(s64 size)
+// Constant initialized, so there is nothing to set up when a thread starts. The magazines of a thread that exits are leaked, but our
+// threads live as long as the process.
+ThreadLocal auto globalHeapMagazines = arr::Static<GlobalHeapMagazine, HeapSizeClassCount>{};
+// ThreadID is a syscall, so look it up once per thread.
+ThreadLocal auto globalHeapThreadID = s64{};
+
+s64 GlobalHeapThreadID()
 {
-	if (this->lock.IsLocked() && this->lockThreadID == ThreadID())
+	if (!globalHeapThreadID)
 	{
-		return this->backup.Allocate(size);
+		globalHeapThreadID = ThreadID();
 	}
+	return globalHeapThreadID;
+}
+
+// Takes half a magazine's worth of blocks from the shared lists, carving new ones out of the heap if those run dry.
+void GlobalHeapAllocator::RefillMagazine(GlobalHeapMagazine *m, s64 sizeClass)
+{
+	this->lock.Lock();
+	this->lockThreadID = GlobalHeapThreadID();
+	Defer(
+	{
+		this->lockThreadID = -1;
+		this->lock.Unlock();
+	});
+	auto central = &this->centralFreeBlocks[sizeClass];
+	while (m->count < GlobalHeapMagazineSize / 2 && central->count > 0)
+	{
+		m->blocks[m->count] = central->Pop();
+		m->count += 1;
+	}
+	auto size = HeapSizeClassSize(sizeClass);
+	while (m->count < GlobalHeapMagazineSize / 2)
+	{
+		m->blocks[m->count] = this->heap.AllocateAligned(size, DefaultAlignment);
+		m->count += 1;
+	}
+}
+
+// Returns the count most recently freed blocks in the magazine to the shared lists.
+void GlobalHeapAllocator::FlushMagazine(GlobalHeapMagazine *m, s64 sizeClass, s64 count)
+{
+	Assert(count <= m->count);
 	this->lock.Lock();
-	this->lockThreadID = ThreadID();
+	this->lockThreadID = GlobalHeapThreadID();
 	Defer(
 	{
 		this->lockThreadID = -1;
 		this->lock.Unlock();
 	});
-	return this->heap.Allocate(size);
+	auto central = &this->centralFreeBlocks[sizeClass];
+	for (auto i = 0; i < count; i += 1)
+	{
+		m->count -= 1;
+		central->Append(m->blocks[m->count]);
+	}
+}
+
+void *GlobalHeapAllocator::Allocate(s64 size)
+{
+	return this->AllocateFromCallsite(size, DefaultAlignment, AllocationCallsite());
 }
 
 void *GlobalHeapAllocator::AllocateAligned(s64 size, s64 align)
 {
-	if (this->lock.IsLocked() && this->lockThreadID == ThreadID())
+	return this->AllocateFromCallsite(size, align, AllocationCallsite());
+}
+
+bool InGlobalHeapBackup(GlobalHeapAllocator *a, void *mem)
+{
+	return mem >= a->backupBuffer.elements && mem < a->backupBuffer.elements + a->backupBuffer.Count();
+}
+
+void *GlobalHeapAllocator::AllocateFromCallsite(s64 size, s64 align, void *callsite)
+{
+	auto mem = this->AllocateUntracked(size, align);
+	#ifdef DevelopmentBuild
+		if (!InGlobalHeapBackup(this, mem))
+		{
+			this->tracker.Allocate(GetAllocationHeader(mem), callsite);
+		}
+	#endif
+	return mem;
+}
+
+void *GlobalHeapAllocator::AllocateUntracked(s64 size, s64 align)
+{
+	if (this->lock.IsLocked() && this->lockThreadID == GlobalHeapThreadID())
 	{
 		return this->backup.AllocateAligned(size, align);
 	}
+	if (auto c = HeapSizeClass(size); c >= 0 && align <= DefaultAlignment)
+	{
+		auto m = &globalHeapMagazines[c];
+		if (m->count == 0)
+		{
+			this->RefillMagazine(m, c);
+		}
+		m->count -= 1;
+		return m->blocks[m->count];
+	}
 	this->lock.Lock();
-	this->lockThreadID = ThreadID();
+	this->lockThreadID = GlobalHeapThreadID();
 	Defer(
 	{
 		this->lockThreadID = -1;
@@ -137,28 +281,99 @@ void *GlobalHeapAllocator::AllocateAligned(s64 size, s64 align)
 
 void *GlobalHeapAllocator::Resize(void *mem, s64 newSize)
 {
-	if (this->lock.IsLocked() && this->lockThreadID == ThreadID())
+	if (this->lock.IsLocked() && this->lockThreadID == GlobalHeapThreadID())
 	{
 		return this->backup.Resize(mem, newSize);
 	}
+	if (InGlobalHeapBackup(this, mem))
+	{
+		// Memory from the backup allocator has no header to tell us its size. It's only used while the heap is locked, so it's small.
+		auto newMem = this->Allocate(newSize);
+		auto avail = (s64)(this->backupBuffer.elements + this->backupBuffer.Count() - (u8 *)mem);
+		if (avail > newSize)
+		{
+			avail = newSize;
+		}
+		arr::Copy(arr::NewView((u8 *)mem, avail), arr::NewView((u8 *)newMem, avail));
+		return newMem;
+	}
+	if (this->ResizeInPlace(mem, newSize))
+	{
+		return mem;
+	}
+	auto h = GetAllocationHeader(mem);
+	auto n = (newSize < h->size) ? newSize : h->size;
+	auto newMem = this->AllocateFromCallsite(newSize, h->alignment, AllocationCallsite());
+	arr::Copy(arr::NewView((u8 *)mem, n), arr::NewView((u8 *)newMem, n));
+	this->Deallocate(mem);
+	return newMem;
+}
+
+bool GlobalHeapAllocator::ResizeInPlace(void *mem, s64 newSize)
+{
+	if (this->lock.IsLocked() && this->lockThreadID == GlobalHeapThreadID())
+	{
+		return this->backup.ResizeInPlace(mem, newSize);
+	}
+	if (InGlobalHeapBackup(this, mem))
+	{
+		return false;
+	}
+	auto h = GetAllocationHeader(mem);
+	if (h->size <= HeapMaxSmallSize && h->alignment <= DefaultAlignment)
+	{
+		// Small blocks are rounded up to their size class, so this is common for arrays growing a little at a time. It doesn't touch the
+		// heap, so there's no need to take the lock.
+		return newSize <= h->size;
+	}
+	auto oldSize = h->size;
 	this->lock.Lock();
-	this->lockThreadID = ThreadID();
+	this->lockThreadID = GlobalHeapThreadID();
 	Defer(
 	{
 		this->lockThreadID = -1;
 		this->lock.Unlock();
 	});
-	return this->heap.Resize(mem, newSize);
+	if (!this->heap.ResizeInPlace(mem, newSize))
+	{
+		return false;
+	}
+	#ifdef DevelopmentBuild
+		this->tracker.Resize(h, oldSize);
+	#endif
+	return true;
 }
 
 void GlobalHeapAllocator::Deallocate(void *mem)
 {
-	if (this->lock.IsLocked() && this->lockThreadID == ThreadID())
+	if (InGlobalHeapBackup(this, mem))
 	{
 		this->backup.Deallocate(mem);
+		return;
+	}
+	auto h = GetAllocationHeader(mem);
+	#ifdef DevelopmentBuild
+		this->tracker.Deallocate(h);
+	#endif
+	if (this->lock.IsLocked() && this->lockThreadID == GlobalHeapThreadID())
+	{
+		// Freed while the heap is busy on this thread. Leak it rather than deadlock.
+		return;
+	}
+	if (auto c = HeapSizeClass(h->size); c >= 0 && h->alignment == DefaultAlignment && HeapSizeClassSize(c) == h->size)
+	{
+		// Any block of a class's exact size is interchangeable with the blocks the magazines hand out.
+		auto m = &globalHeapMagazines[c];
+		if (m->count == GlobalHeapMagazineSize)
+		{
+			this->FlushMagazine(m, c, GlobalHeapMagazineSize / 2);
+		}
+		m->blocks[m->count] = mem;
+		m->count += 1;
+		return;
 	}
 	this->lock.Lock();
-	this->lockThreadID = ThreadID();
+	this->lockThreadID = GlobalHeapThreadID();
 	Defer(
 	{
 		this->lockThreadID = -1;
@@ -169,34 +384,40 @@ void GlobalHeapAllocator::Deallocate(void *mem)
 
 void GlobalHeapAllocator::Clear()
 {
-	if (this->lock.IsLocked() && this->lockThreadID == ThreadID())
+	if (this->lock.IsLocked() && this->lockThreadID == GlobalHeapThreadID())
 	{
 		return;
 	}
 	this->lock.Lock();
-	this->lockThreadID = ThreadID();
+	this->lockThreadID = GlobalHeapThreadID();
 	Defer(
 	{
 		this->lockThreadID = -1;
 		this->lock.Unlock();
 	});
 	this->heap.Clear();
+	#ifdef DevelopmentBuild
+		this->tracker.Clear();
+	#endif
 }
 
 void GlobalHeapAllocator::Free()
 {
-	if (this->lock.IsLocked() && this->lockThreadID == ThreadID())
+	if (this->lock.IsLocked() && this->lockThreadID == GlobalHeapThreadID())
 	{
 		return;
 	}
 	this->lock.Lock();
-	this->lockThreadID = ThreadID();
+	this->lockThreadID = GlobalHeapThreadID();
 	Defer(
 	{
 		this->lockThreadID = -1;
 		this->lock.Unlock();
 	});
 	this->heap.Free();
+	#ifdef DevelopmentBuild
+		this->tracker.Clear();
+	#endif
 }
 
 // @TODO: Make the backup allocator its own thing, not a stack allocator.
@@ -211,7 +432,7 @@ GlobalHeapAllocator *GlobalHeap()
 	if (!init)
 	{
 		alloc.lock.Lock();
-		alloc.lockThreadID = ThreadID();
+		alloc.lockThreadID = GlobalHeapThreadID();
 		Defer(
 		{
 			alloc.lockThreadID = -1;
@@ -220,11 +441,96 @@ GlobalHeapAllocator *GlobalHeap()
 		if (!init)
 		{
 			alloc.backup = NewStackAllocator(alloc.backupBuffer);
+			blockAlloc.blocks = arr::NewIn<GlobalHeapBlock>(&arrayAlloc, 0);
 			alloc.heap = NewHeapAllocator(GlobalHeapBlockSize, 32, &blockAlloc, &arrayAlloc);
+			alloc.heap.blocks.pageStrategy = GlobalHeapBlockPageStrategy;
+			for (auto &c : alloc.centralFreeBlocks)
+			{
+				c = arr::NewIn<void *>(&arrayAlloc, 0);
+			}
+			alloc.trimPolicy = DefaultGlobalHeapTrimPolicy;
+			alloc.lastTrimTime = time::Now();
+			#ifdef DevelopmentBuild
+				RegisterAllocationTracker(&alloc.tracker, "Global heap");
+			#endif
 			init = true;
 		}
 	}
 	return &alloc;
 }
 
+// Returns how many of the global heap's blocks got each kind of page.
+arr::Static<s64, PlatformPageStrategyCount> GlobalHeapPageStrategies()
+{
+	auto h = GlobalHeap();
+	h->lock.Lock();
+	h->lockThreadID = GlobalHeapThreadID();
+	Defer(
+	{
+		h->lockThreadID = -1;
+		h->lock.Unlock();
+	});
+	return ((GlobalHeapBlockAllocator *)h->heap.blocks.allocator)->pageStrategyCounts;
+}
+
+void SetGlobalHeapTrimPolicy(GlobalHeapTrimPolicy p)
+{
+	auto h = GlobalHeap();
+	h->lock.Lock();
+	h->lockThreadID = GlobalHeapThreadID();
+	Defer(
+	{
+		h->lockThreadID = -1;
+		h->lock.Unlock();
+	});
+	h->trimPolicy = p;
+}
+
+// Must be called with the lock held.
+s64 TrimGlobalHeapLocked(GlobalHeapAllocator *h)
+{
+	auto n = h->heap.Trim();
+	h->trimmedBytes += n;
+	h->lastTrimTime = time::Now();
+	return n;
+}
+
+// Gives the pages of the heap's free memory back to the OS, and returns how many bytes that was. Small blocks sitting in the magazines
+// and on the shared lists are not given back.
+s64 TrimGlobalHeap()
+{
+	auto h = GlobalHeap();
+	h->lock.Lock();
+	h->lockThreadID = GlobalHeapThreadID();
+	Defer(
+	{
+		h->lockThreadID = -1;
+		h->lock.Unlock();
+	});
+	return TrimGlobalHeapLocked(h);
+}
+
+// Trims the heap if the trim policy says to. Cheap enough to call once a frame.
+void UpdateGlobalHeapTrim()
+{
+	auto h = GlobalHeap();
+	h->lock.Lock();
+	h->lockThreadID = GlobalHeapThreadID();
+	Defer(
+	{
+		h->lockThreadID = -1;
+		h->lock.Unlock();
+	});
+	auto p = h->trimPolicy;
+	auto freed = h->heap.freedBytes;
+	if (freed == 0)
+	{
+		return;
+	}
+	if ((p.freedBudget > 0 && freed > p.freedBudget) || (p.idleNanoseconds > 0 && (time::Now() - h->lastTrimTime).nanoseconds >= p.idleNanoseconds))
+	{
+		TrimGlobalHeapLocked(h);
+	}
+}
+
 }
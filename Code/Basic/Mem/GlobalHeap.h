@@ -1,13 +1,41 @@
 #pragma once
 
+#include "Memory.h"
 #include "HeapAllocator.h"
+#include "AllocationTracker.h"
 #include "StackAllocator.h"
 #include "Basic/Thread.h"
+#include "Basic/Time/Time.h"
 #include "Basic/Container/Array.h"
 
 namespace mem
 {
 
+// Small allocations are rounded up to one of the heap's size classes and served from per-thread magazines, so the common case never takes
+// the global heap lock. A thread refills an empty magazine in one batch, and once a magazine fills up it returns half of its blocks to the shared per-class
+// lists in one batch. Memory freed by a thread other than the one that allocated it simply goes into the freeing thread's magazine.
+const auto GlobalHeapMagazineSize = 64;
+
+struct GlobalHeapMagazine
+{
+	s64 count;
+	void *blocks[GlobalHeapMagazineSize];
+};
+
+// Memory freed to the global heap stays resident until the heap is trimmed. UpdateGlobalHeapTrim trims when either limit in the policy is
+// hit, and TrimGlobalHeap trims right away, for instance after unloading a level.
+struct GlobalHeapTrimPolicy
+{
+	s64 idleNanoseconds; // Trim if memory has been freed and the heap hasn't been trimmed for this long. Zero turns this off.
+	s64 freedBudget; // Trim once more than this many bytes have been freed since the last trim. Zero turns this off.
+};
+
+const auto DefaultGlobalHeapTrimPolicy = GlobalHeapTrimPolicy
+{
+	.idleNanoseconds = 10 * time::Second,
+	.freedBudget = 256 * Megabyte,
+};
+
 struct GlobalHeapAllocator : Allocator
 {
 	Spinlock lock;
@@ -15,15 +43,32 @@ struct GlobalHeapAllocator : Allocator
 	HeapAllocator heap;
 	StackAllocator backup;
 	arr::Static<u8, 8 * Megabyte> backupBuffer;
+	arr::Static<arr::array<void *>, HeapSizeClassCount> centralFreeBlocks; // Guarded by lock.
+	GlobalHeapTrimPolicy trimPolicy; // Guarded by lock.
+	time::Time lastTrimTime; // Guarded by lock.
+	s64 trimmedBytes; // Decommitted by all trims so far. Guarded by lock.
+	#ifdef DevelopmentBuild
+		AllocationTracker tracker;
+	#endif
+
+	void RefillMagazine(GlobalHeapMagazine *m, s64 sizeClass);
+	void FlushMagazine(GlobalHeapMagazine *m, s64 sizeClass, s64 count);
+	void *AllocateFromCallsite(s64 size, s64 align, void *callsite);
+	void *AllocateUntracked(s64 size, s64 align);
 
 	void *Allocate(s64 size);
 	void *AllocateAligned(s64 size, s64 align);
 	void *Resize(void *mem, s64 newSize);
+	bool ResizeInPlace(void *mem, s64 newSize);
 	void Deallocate(void *mem);
 	void Clear();
 	void Free();
 };
 
 GlobalHeapAllocator *GlobalHeap();
+arr::Static<s64, PlatformPageStrategyCount> GlobalHeapPageStrategies();
+void SetGlobalHeapTrimPolicy(GlobalHeapTrimPolicy p);
+s64 TrimGlobalHeap();
+void UpdateGlobalHeapTrim();
 
 }
@@ -1,16 +1,331 @@
 #include "HeapAllocator.h"
+#include "Memory.h"
 
 namespace mem
 {
 
+const auto HeapChunkHeaderSize = (s64)offsetof(HeapChunk, nextFree);
+const auto HeapMinChunkSize = (s64)sizeof(HeapChunk);
+// Medium and huge allocations store a pointer back to their chunk or mapping right before the allocation header, so the header can be
+// found from the data pointer like any other allocation, whatever the alignment. Rounded up to the default alignment, since that's where
+// SetHeapChunkHeaderAndData puts the data. The header grows in development builds, and the chunk sizing has to agree with the real offset.
+const auto HeapChunkDataOverhead = (s64)((sizeof(void *) + sizeof(AllocationHeader) + sizeof(s64) + DefaultAlignment - 1) / DefaultAlignment * DefaultAlignment);
+
+static_assert(HeapChunkHeaderSize % DefaultAlignment == 0);
+
+static_assert(sizeof(HeapHugeMapping) % DefaultAlignment == 0);
+
 HeapAllocator NewHeapAllocator(s64 blockSize, s64 blockCount, Allocator *blockAlloc, Allocator *arrayAlloc)
 {
 	auto a = HeapAllocator{};
 	a.blocks = NewBlockAllocator(blockSize, blockCount, blockAlloc, arrayAlloc);
-	a.free = arr::NewIn<AllocationHeader *>(arrayAlloc, 0);
+	// Leave room in the block for aligning the span.
+	a.spanSize = AlignAddress(blockSize / 2, DefaultAlignment);
+	if (a.spanSize > HeapMaxSpanSize)
+	{
+		a.spanSize = HeapMaxSpanSize;
+	}
+	a.maxMediumSize = a.spanSize / 4;
 	return a;
 }
 
+s64 HeapSizeClass(s64 size)
+{
+	if (size <= 128)
+	{
+		return (size > 0) ? (size - 1) / 16 : 0;
+	}
+	if (size > HeapMaxSmallSize)
+	{
+		return -1;
+	}
+	auto shift = 63 - __builtin_clzll(size - 1);
+	return 8 + ((shift - 7) * 4) + ((size - 1) >> (shift - 2)) - 4;
+}
+
+s64 HeapSizeClassSize(s64 sizeClass)
+{
+	if (sizeClass < 8)
+	{
+		return (sizeClass + 1) * 16;
+	}
+	auto shift = 7 + ((sizeClass - 8) / 4);
+	return (1 << shift) + ((((sizeClass - 8) % 4) + 1) << (shift - 2));
+}
+
+u8 *SetHeapChunkHeaderAndData(void *owner, u8 *mem, s64 size, s64 align)
+{
+	auto dat = (u8 *)AlignPointer(mem + HeapChunkDataOverhead, (align > DefaultAlignment) ? align : DefaultAlignment);
+	auto hdr = (AllocationHeader *)(dat - sizeof(AllocationHeader) - sizeof(s64));
+	*((void **)hdr - 1) = owner;
+	hdr->size = size;
+	hdr->alignment = align;
+	*(dat - 1) = dat - (u8 *)hdr;
+	return dat;
+}
+
+void *HeapChunkOwner(AllocationHeader *h)
+{
+	return *((void **)h - 1);
+}
+
+s64 HeapChunkSize(HeapChunk *c)
+{
+	return c->size & ~1;
+}
+
+bool IsHeapChunkFree(HeapChunk *c)
+{
+	return c->size & 1;
+}
+
+HeapChunk *NextPhysicalHeapChunk(HeapChunk *c)
+{
+	return (HeapChunk *)((u8 *)c + HeapChunkSize(c));
+}
+
+void HeapChunkMapping(s64 size, s64 *fl, s64 *sl)
+{
+	if (size < (1 << (HeapSecondLevelBits + 4)))
+	{
+		// Below 256 bytes the second level is linear, 16 bytes per list.
+		*fl = 0;
+		*sl = size / 16;
+		return;
+	}
+	auto log = 63 - __builtin_clzll(size);
+	*fl = log - (HeapSecondLevelBits + 4) + 1;
+	*sl = (size >> (log - HeapSecondLevelBits)) - HeapSecondLevelCount;
+}
+
+void InsertFreeHeapChunk(HeapAllocator *a, HeapChunk *c)
+{
+	auto fl = s64{}, sl = s64{};
+	HeapChunkMapping(HeapChunkSize(c), &fl, &sl);
+	auto head = a->freeChunks[fl][sl];
+	c->nextFree = head;
+	c->previousFree = NULL;
+	if (head)
+	{
+		head->previousFree = c;
+	}
+	a->freeChunks[fl][sl] = c;
+	a->firstLevelBitmap |= 1ull << fl;
+	a->secondLevelBitmaps[fl] |= 1u << sl;
+	c->size |= 1;
+}
+
+void RemoveFreeHeapChunk(HeapAllocator *a, HeapChunk *c)
+{
+	auto fl = s64{}, sl = s64{};
+	HeapChunkMapping(HeapChunkSize(c), &fl, &sl);
+	if (c->previousFree)
+	{
+		c->previousFree->nextFree = c->nextFree;
+	}
+	else
+	{
+		a->freeChunks[fl][sl] = c->nextFree;
+	}
+	if (c->nextFree)
+	{
+		c->nextFree->previousFree = c->previousFree;
+	}
+	if (!a->freeChunks[fl][sl])
+	{
+		a->secondLevelBitmaps[fl] &= ~(1u << sl);
+		if (!a->secondLevelBitmaps[fl])
+		{
+			a->firstLevelBitmap &= ~(1ull << fl);
+		}
+	}
+	c->size &= ~1;
+}
+
+// Returns a free chunk of at least size bytes, or NULL. The size is rounded up to the next list first, so that any chunk on the list
+// that is found is big enough without searching it.
+HeapChunk *FindFreeHeapChunk(HeapAllocator *a, s64 size)
+{
+	if (size >= (1 << (HeapSecondLevelBits + 4)))
+	{
+		size += (1ll << ((63 - __builtin_clzll(size)) - HeapSecondLevelBits)) - 1;
+	}
+	auto fl = s64{}, sl = s64{};
+	HeapChunkMapping(size, &fl, &sl);
+	if (fl >= HeapFirstLevelCount)
+	{
+		return NULL;
+	}
+	auto slMap = a->secondLevelBitmaps[fl] & (~0u << sl);
+	if (!slMap)
+	{
+		auto flMap = a->firstLevelBitmap & (~0ull << (fl + 1));
+		if (!flMap)
+		{
+			return NULL;
+		}
+		fl = __builtin_ctzll(flMap);
+		slMap = a->secondLevelBitmaps[fl];
+	}
+	sl = __builtin_ctz(slMap);
+	return a->freeChunks[fl][sl];
+}
+
+// Takes a new span from the block allocator and puts it on the free lists as one big chunk. The span ends with a header-only chunk that
+// is never free, so coalescing stops there.
+void AddHeapSpan(HeapAllocator *a, s64 minSize)
+{
+	auto size = a->spanSize;
+	if (size < (2 * minSize) + HeapChunkHeaderSize)
+	{
+		size = AlignAddress((2 * minSize) + HeapChunkHeaderSize, DefaultAlignment);
+	}
+	auto c = (HeapChunk *)a->blocks.Allocate(size, DefaultAlignment);
+	c->previousSize = 0;
+	c->size = size - HeapChunkHeaderSize;
+	auto end = NextPhysicalHeapChunk(c);
+	end->previousSize = c->size;
+	end->size = 0;
+	InsertFreeHeapChunk(a, c);
+}
+
+// Shrinks the allocated chunk c to size bytes and frees the tail, as long as the tail is big enough to be a chunk of its own.
+void SplitHeapChunk(HeapAllocator *a, HeapChunk *c, s64 size)
+{
+	auto rest = HeapChunkSize(c) - size;
+	if (rest < HeapMinChunkSize)
+	{
+		return;
+	}
+	c->size = size;
+	auto r = NextPhysicalHeapChunk(c);
+	r->previousSize = size;
+	r->size = rest;
+	auto next = NextPhysicalHeapChunk(r);
+	if (IsHeapChunkFree(next))
+	{
+		// Only happens when shrinking in place. A chunk taken from the free lists never has a free neighbor.
+		RemoveFreeHeapChunk(a, next);
+		r->size += next->size;
+	}
+	NextPhysicalHeapChunk(r)->previousSize = r->size;
+	InsertFreeHeapChunk(a, r);
+}
+
+void *AllocateMediumHeapChunk(HeapAllocator *a, s64 size, s64 align)
+{
+	auto need = HeapChunkHeaderSize + HeapChunkDataOverhead + size + ((align > DefaultAlignment) ? align - DefaultAlignment : 0);
+	need = AlignAddress(need, DefaultAlignment);
+	auto c = FindFreeHeapChunk(a, need);
+	if (!c)
+	{
+		AddHeapSpan(a, need);
+		c = FindFreeHeapChunk(a, need);
+		Assert(c);
+	}
+	RemoveFreeHeapChunk(a, c);
+	SplitHeapChunk(a, c, need);
+	return SetHeapChunkHeaderAndData(c, (u8 *)c + HeapChunkHeaderSize, size, align);
+}
+
+// Grows the chunk into the free chunk after it if it has to, then gives back whatever is left over past the new end of the allocation.
+bool ResizeMediumHeapChunk(HeapAllocator *a, HeapChunk *c, AllocationHeader *h, void *mem, s64 newSize)
+{
+	auto need = (s64)AlignAddress(((u8 *)mem - (u8 *)c) + newSize, DefaultAlignment);
+	auto size = HeapChunkSize(c);
+	if (need > size)
+	{
+		auto next = NextPhysicalHeapChunk(c);
+		if (!IsHeapChunkFree(next) || size + HeapChunkSize(next) < need)
+		{
+			return false;
+		}
+		RemoveFreeHeapChunk(a, next);
+		c->size += next->size;
+		NextPhysicalHeapChunk(c)->previousSize = c->size;
+	}
+	SplitHeapChunk(a, c, need);
+	h->size = newSize;
+	return true;
+}
+
+void DeallocateMediumHeapChunk(HeapAllocator *a, HeapChunk *c)
+{
+	a->freedBytes += HeapChunkSize(c);
+	auto next = NextPhysicalHeapChunk(c);
+	if (IsHeapChunkFree(next))
+	{
+		RemoveFreeHeapChunk(a, next);
+		c->size += next->size;
+	}
+	if (c->previousSize)
+	{
+		auto prev = (HeapChunk *)((u8 *)c - c->previousSize);
+		if (IsHeapChunkFree(prev))
+		{
+			RemoveFreeHeapChunk(a, prev);
+			prev->size += c->size;
+			c = prev;
+		}
+	}
+	NextPhysicalHeapChunk(c)->previousSize = c->size;
+	InsertFreeHeapChunk(a, c);
+}
+
+void *AllocateHugeHeapMapping(HeapAllocator *a, s64 size, s64 align)
+{
+	auto mapSize = (s64)AlignAddress(sizeof(HeapHugeMapping) + HeapChunkDataOverhead + size + align, CPUPageSize());
+	auto m = (HeapHugeMapping *)PlatformAllocate(mapSize);
+	*m = HeapHugeMapping
+	{
+		.size = mapSize,
+		.next = a->hugeMappings,
+	};
+	if (a->hugeMappings)
+	{
+		a->hugeMappings->previous = m;
+	}
+	a->hugeMappings = m;
+	return SetHeapChunkHeaderAndData(m, (u8 *)(m + 1), size, align);
+}
+
+bool ResizeHugeHeapMapping(HeapHugeMapping *m, AllocationHeader *h, void *mem, s64 newSize)
+{
+	auto mapSize = (s64)AlignAddress(((u8 *)mem - (u8 *)m) + newSize, CPUPageSize());
+	if (mapSize != m->size)
+	{
+		if (!PlatformResize(m, m->size, mapSize))
+		{
+			return false;
+		}
+		m->size = mapSize;
+	}
+	h->size = newSize;
+	return true;
+}
+
+void DeallocateHugeHeapMapping(HeapAllocator *a, HeapHugeMapping *m)
+{
+	if (m->previous)
+	{
+		m->previous->next = m->next;
+	}
+	else
+	{
+		a->hugeMappings = m->next;
+	}
+	if (m->next)
+	{
+		m->next->previous = m->previous;
+	}
+	PlatformDeallocate(m, m->size);
+}
+
+bool IsSmallHeapAllocation(AllocationHeader *h)
+{
+	return h->size <= HeapMaxSmallSize && h->alignment <= DefaultAlignment;
+}
+
 void *HeapAllocator::Allocate(s64 size)
 {
 	return this->AllocateAligned(size, DefaultAlignment);
@@ -18,35 +333,113 @@ void *HeapAllocator::Allocate(s64 size)
 
 void *HeapAllocator::AllocateAligned(s64 size, s64 align)
 {
-	return this->blocks.AllocateWithHeader(size, align);
+	if (align <= DefaultAlignment && size <= HeapMaxSmallSize)
+	{
+		auto c = HeapSizeClass(size);
+		if (auto m = this->smallFreeLists[c]; m)
+		{
+			this->smallFreeLists[c] = *(void **)m;
+			return m;
+		}
+		return this->blocks.AllocateWithHeader(HeapSizeClassSize(c), DefaultAlignment);
+	}
+	if (size > this->maxMediumSize)
+	{
+		return AllocateHugeHeapMapping(this, size, align);
+	}
+	return AllocateMediumHeapChunk(this, size, align);
 }
 
 void *HeapAllocator::Resize(void *mem, s64 newSize)
 {
+	if (this->ResizeInPlace(mem, newSize))
+	{
+		return mem;
+	}
 	auto h = GetAllocationHeader(mem);
-	Assert(newSize >= h->size);
-	auto newMem = this->blocks.AllocateWithHeader(newSize, h->alignment);
-	arr::Copy(arr::NewView((u8 *)mem, h->size), arr::NewView((u8 *)newMem, h->size));
-	this->free.Append(h);
+	auto n = (newSize < h->size) ? newSize : h->size;
+	auto newMem = this->AllocateAligned(newSize, h->alignment);
+	arr::Copy(arr::NewView((u8 *)mem, n), arr::NewView((u8 *)newMem, n));
+	this->Deallocate(mem);
 	return newMem;
 }
 
+bool HeapAllocator::ResizeInPlace(void *mem, s64 newSize)
+{
+	auto h = GetAllocationHeader(mem);
+	if (IsSmallHeapAllocation(h))
+	{
+		// The header keeps the size class's size, so the block goes back on the right free list.
+		return newSize <= h->size;
+	}
+	// Deallocate tells the tiers apart by the size in the header, so an allocation can't move between tiers.
+	if (newSize <= HeapMaxSmallSize && h->alignment <= DefaultAlignment)
+	{
+		return false;
+	}
+	if (h->size > this->maxMediumSize)
+	{
+		return newSize > this->maxMediumSize && ResizeHugeHeapMapping((HeapHugeMapping *)HeapChunkOwner(h), h, mem, newSize);
+	}
+	return newSize <= this->maxMediumSize && ResizeMediumHeapChunk(this, (HeapChunk *)HeapChunkOwner(h), h, mem, newSize);
+}
+
 void HeapAllocator::Deallocate(void *mem)
 {
 	auto h = GetAllocationHeader(mem);
-	this->free.Append(h);
+	if (IsSmallHeapAllocation(h))
+	{
+		auto c = HeapSizeClass(h->size);
+		*(void **)mem = this->smallFreeLists[c];
+		this->smallFreeLists[c] = mem;
+		return;
+	}
+	if (h->size > this->maxMediumSize)
+	{
+		DeallocateHugeHeapMapping(this, (HeapHugeMapping *)HeapChunkOwner(h));
+		return;
+	}
+	DeallocateMediumHeapChunk(this, (HeapChunk *)HeapChunkOwner(h));
+}
+
+// Decommits the pages of every free medium chunk, except for the first one, which holds the chunk's header and free list links. Spans
+// that are entirely free end up with next to nothing resident. Chunks in huge page blocks only give back the huge pages they cover
+// entirely.
+s64 HeapAllocator::Trim()
+{
+	auto n = this->blocks.Trim();
+	for (auto &fl : this->freeChunks)
+	{
+		for (auto c : fl)
+		{
+			for (; c; c = c->nextFree)
+			{
+				n += DecommitPages(c + 1, NextPhysicalHeapChunk(c), this->blocks.BlockPageSize(this->blocks.FindBlock(c)));
+			}
+		}
+	}
+	this->freedBytes = 0;
+	return n;
 }
 
 void HeapAllocator::Clear()
 {
 	this->blocks.Clear();
-	this->free.Resize(0);
+	this->smallFreeLists = {};
+	this->firstLevelBitmap = 0;
+	this->secondLevelBitmaps = {};
+	this->freeChunks = {};
+	this->freedBytes = 0;
+	while (this->hugeMappings)
+	{
+		DeallocateHugeHeapMapping(this, this->hugeMappings);
+	}
 }
 
 void HeapAllocator::Free()
 {
-	// @TODO
-	this->free.Resize(0);
+	this->Clear();
+	this->blocks.Free();
 }
 
 }
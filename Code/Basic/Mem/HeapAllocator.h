@@ -7,19 +7,61 @@
 namespace mem
 {
 
+// Small allocations are rounded up to a size class and recycled through a free list per class. Classes are 16 bytes apart up to 128
+// bytes, then four classes per power of two up to HeapMaxSmallSize.
+const auto HeapSizeClassCount = 20;
+const auto HeapMaxSmallSize = 1024;
+
+// Medium allocations are carved out of spans taken from the block allocator and managed with a two-level segregated fit (TLSF) allocator.
+// Freed chunks are coalesced with their free neighbors, and finding a chunk that fits is constant time. Anything bigger than a quarter of
+// a span gets its own mapping from the OS and is unmapped as soon as it is freed.
+//
+// Trim gives the pages inside free medium chunks back to the OS. Small blocks are never given back, they stay on their free lists.
+const auto HeapSecondLevelBits = 4;
+const auto HeapSecondLevelCount = 1 << HeapSecondLevelBits;
+const auto HeapFirstLevelCount = 32;
+const auto HeapMaxSpanSize = 4 * Megabyte;
+
+struct HeapChunk
+{
+	s64 previousSize; // The size of the chunk physically before this one in its span, or 0 if this is the first chunk.
+	s64 size; // Includes this header. The low bit is set while the chunk is free.
+	HeapChunk *nextFree; // The free list links overlap the allocation, so they're only valid while the chunk is free.
+	HeapChunk *previousFree;
+};
+
+struct HeapHugeMapping
+{
+	s64 size;
+	HeapHugeMapping *previous;
+	HeapHugeMapping *next;
+	s64 padding;
+};
+
 struct HeapAllocator : Allocator
 {
 	BlockAllocator blocks;
-	arr::array<AllocationHeader *> free;
+	s64 spanSize;
+	s64 maxMediumSize;
+	arr::Static<void *, HeapSizeClassCount> smallFreeLists;
+	u64 firstLevelBitmap;
+	arr::Static<u32, HeapFirstLevelCount> secondLevelBitmaps;
+	arr::Static<arr::Static<HeapChunk *, HeapSecondLevelCount>, HeapFirstLevelCount> freeChunks;
+	HeapHugeMapping *hugeMappings;
+	s64 freedBytes; // Medium chunk bytes freed since the last trim.
 
+	s64 Trim();
 	void *Allocate(s64 size);
 	void *AllocateAligned(s64 size, s64 align);
 	void *Resize(void *mem, s64 newSize);
+	bool ResizeInPlace(void *mem, s64 newSize);
 	void Deallocate(void *mem);
 	void Clear();
 	void Free();
 };
 
 HeapAllocator NewHeapAllocator(s64 blockSize, s64 blockCount, Allocator *blockAlloc, Allocator *arrayAlloc);
+s64 HeapSizeClass(s64 size);
+s64 HeapSizeClassSize(s64 sizeClass);
 
 }
@@ -1,5 +1,7 @@
 #include "Memory.h"
 #include "ContextAllocator.h"
+#include "Basic/CPU.h"
+#include "Basic/Log.h"
 
 namespace mem
 {
@@ -38,4 +40,32 @@ void *AlignPointer(void *addr, s64 align)
 	return (void *)AlignAddress((PointerInt)addr, align);
 }
 
+// The granularity memory with the given kind of pages can be decommitted at.
+s64 PageStrategySize(PlatformPageStrategy s)
+{
+	if (s == PlatformSmallPages)
+	{
+		return CPUPageSize();
+	}
+	return HugePageSize;
+}
+
+// Decommits the whole pages between begin and end, and returns how many bytes that was. The page size has to match the memory: explicit
+// huge pages can't be decommitted in smaller pieces, and decommitting part of a transparent huge page splits it.
+s64 DecommitPages(void *begin, void *end, s64 pageSize)
+{
+	auto b = AlignAddress((PointerInt)begin, pageSize);
+	auto e = (PointerInt)end & ~(PointerInt)(pageSize - 1);
+	if (e <= b)
+	{
+		return 0;
+	}
+	if (!PlatformDecommit((void *)b, e - b))
+	{
+		log::Error("Memory", "Failed to decommit %d bytes with %d byte pages: %k.", e - b, pageSize, PlatformError());
+		return 0;
+	}
+	return e - b;
+}
+
 }
@@ -15,5 +15,7 @@ void *Resize(void *mem, s64 newSize);
 void Deallocate(void *mem);
 PointerInt AlignAddress(PointerInt addr, s64 align);
 void *AlignPointer(void *addr, s64 align);
+s64 PageStrategySize(PlatformPageStrategy s);
+s64 DecommitPages(void *begin, void *end, s64 pageSize);
 
 }
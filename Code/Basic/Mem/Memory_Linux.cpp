@@ -6,14 +6,82 @@ namespace mem
 {
 
 #define MAP_ANONYMOUS 0x20
+#ifndef MADV_POPULATE_WRITE
+	#define MADV_POPULATE_WRITE 23
+#endif
 
 void *PlatformAllocate(s64 size)
 {
-	auto mem = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-	if (mem == (void *)-1)
+	auto s = PlatformPageStrategy{};
+	return PlatformAllocateWithFlags(size, 0, &s);
+}
+
+void PrefaultMemory(void *mem, s64 size)
+{
+	if (madvise(mem, size, MADV_POPULATE_WRITE) == 0)
+	{
+		return;
+	}
+	// Older kernels don't have MADV_POPULATE_WRITE, so touch the pages ourselves.
+	for (auto p = (volatile u8 *)mem; p < (u8 *)mem + size; p += CPUPageSize())
+	{
+		*p = 0;
+	}
+}
+
+void *PlatformAllocateWithFlags(s64 size, s64 flags, PlatformPageStrategy *strategy)
+{
+	auto mmapFlags = MAP_PRIVATE | MAP_ANONYMOUS;
+	if (flags & PlatformAllocatePrefault)
+	{
+		mmapFlags |= MAP_POPULATE;
+	}
+	if (!(flags & PlatformAllocateHugePages) || size < HugePageSize)
+	{
+		auto mem = mmap(0, size, PROT_READ | PROT_WRITE, mmapFlags, -1, 0);
+		if (mem == (void *)-1)
+		{
+			Abort("Memory", "Failed to allocate memory: %k.", PlatformError());
+		}
+		*strategy = PlatformSmallPages;
+		return mem;
+	}
+	if (size % HugePageSize == 0)
+	{
+		// This fails unless huge pages were reserved ahead of time, which is rare outside of dedicated machines.
+		auto mem = mmap(0, size, PROT_READ | PROT_WRITE, mmapFlags | MAP_HUGETLB, -1, 0);
+		if (mem != (void *)-1)
+		{
+			*strategy = PlatformExplicitHugePages;
+			return mem;
+		}
+	}
+	// Transparent huge pages only back huge page aligned ranges, so map a huge page extra and trim the ends off. Prefaulting has to wait
+	// until after the madvise, or the kernel would fill the range with small pages.
+	auto map = mmap(0, size + HugePageSize, PROT_READ | PROT_WRITE, mmapFlags & ~MAP_POPULATE, -1, 0);
+	if (map == (void *)-1)
 	{
 		Abort("Memory", "Failed to allocate memory: %k.", PlatformError());
 	}
+	auto mem = (u8 *)AlignPointer(map, HugePageSize);
+	if (mem > map)
+	{
+		PlatformDeallocate(map, mem - (u8 *)map);
+	}
+	if (auto tail = ((u8 *)map + size + HugePageSize) - (mem + size); tail > 0)
+	{
+		PlatformDeallocate(mem + size, tail);
+	}
+	*strategy = PlatformTransparentHugePages;
+	if (madvise(mem, size, MADV_HUGEPAGE) == -1)
+	{
+		// Transparent huge pages are turned off or not built into the kernel.
+		*strategy = PlatformSmallPages;
+	}
+	if (flags & PlatformAllocatePrefault)
+	{
+		PrefaultMemory(mem, size);
+	}
 	return mem;
 }
 
@@ -25,4 +93,39 @@ void PlatformDeallocate(void *mem, s64 size)
 	}
 }
 
+// Grows or shrinks a mapping without moving it. Growing fails if the pages after the mapping are already taken.
+bool PlatformResize(void *mem, s64 size, s64 newSize)
+{
+	return mremap(mem, size, newSize, 0) != (void *)-1;
+}
+
+// Takes address space without any memory behind it. Touching the range faults until it is committed. Release it with PlatformDeallocate.
+void *PlatformReserve(s64 size)
+{
+	auto mem = mmap(0, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (mem == (void *)-1)
+	{
+		Abort("Memory", "Failed to reserve memory: %k.", PlatformError());
+	}
+	return mem;
+}
+
+// Makes part of a reserved range usable. The range has to be page aligned. Pages are zeroed, and the kernel only backs them once they are
+// touched.
+void PlatformCommit(void *mem, s64 size)
+{
+	if (mprotect(mem, size, PROT_READ | PROT_WRITE) == -1)
+	{
+		Abort("Memory", "Failed to commit memory: %k.", PlatformError());
+	}
+}
+
+// Gives the pages of a range back to the OS but keeps the range mapped. The range has to be page aligned. It reads back as zeros the next
+// time it's touched. Fails for explicit huge pages unless the range is huge page aligned.
+bool PlatformDecommit(void *mem, s64 size)
+{
+	// MADV_FREE is cheaper, but the kernel only takes those pages back under memory pressure, so the resident size wouldn't come down.
+	return madvise(mem, size, MADV_DONTNEED) == 0;
+}
+
 }
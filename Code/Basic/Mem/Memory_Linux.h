@@ -5,7 +5,26 @@
 namespace mem
 {
 
+// Flags for PlatformAllocateWithFlags.
+const auto PlatformAllocateHugePages = 1 << 0; // Back the memory with huge pages if the system will give us any, to cut down on TLB misses.
+const auto PlatformAllocatePrefault = 1 << 1; // Fault in every page up front, so the memory is fast the first time it's touched.
+
+const auto HugePageSize = 2 * Megabyte;
+
+enum PlatformPageStrategy
+{
+	PlatformSmallPages,
+	PlatformExplicitHugePages, // MAP_HUGETLB, from the pool reserved with vm.nr_hugepages.
+	PlatformTransparentHugePages, // madvise(MADV_HUGEPAGE). The kernel uses huge pages where it can, but it doesn't promise to.
+	PlatformPageStrategyCount
+};
+
 void *PlatformAllocate(s64 size);
+void *PlatformAllocateWithFlags(s64 size, s64 flags, PlatformPageStrategy *strategy);
 void PlatformDeallocate(void *mem, s64 size);
+bool PlatformResize(void *mem, s64 size, s64 newSize);
+void *PlatformReserve(s64 size);
+void PlatformCommit(void *mem, s64 size);
+bool PlatformDecommit(void *mem, s64 size);
 
 }
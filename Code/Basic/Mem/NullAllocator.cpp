@@ -19,6 +19,11 @@ void *NullAllocator::Resize(void *mem, s64 newSize)
 	return NULL;
 }
 
+bool NullAllocator::ResizeInPlace(void *mem, s64 newSize)
+{
+	return false;
+}
+
 void NullAllocator::Deallocate(void *mem)
 {
 }
@@ -12,6 +12,7 @@ struct NullAllocator : Allocator
 	void *Allocate(s64 size);
 	void *AllocateAligned(s64 size, s64 align);
 	void *Resize(void *mem, s64 newSize);
+	bool ResizeInPlace(void *mem, s64 newSize);
 	void Deallocate(void *mem);
 	void Clear();
 	void Free();
@@ -23,16 +23,38 @@ void *PoolAllocator::AllocateAligned(s64 size, s64 align)
 
 void *PoolAllocator::Resize(void *mem, s64 newSize)
 {
+	if (this->ResizeInPlace(mem, newSize))
+	{
+		return mem;
+	}
 	auto h = GetAllocationHeader(mem);
 	auto newMem = this->blocks.AllocateWithHeader(newSize, h->alignment);
 	arr::Copy(array::NewView((u8 *)mem, h->size), array::NewView((u8 *)newMem, h->size));
 	return newMem;
 }
 
+bool PoolAllocator::ResizeInPlace(void *mem, s64 newSize)
+{
+	auto h = GetAllocationHeader(mem);
+	if (this->blocks.ResizeInPlace(mem, h->size, newSize))
+	{
+		h->size = newSize;
+		return true;
+	}
+	// Pool memory is never reused, so a shrunk allocation can just keep its tail.
+	return newSize <= h->size;
+}
+
 void PoolAllocator::Deallocate(void *mem)
 {
 }
 
+// Decommits the blocks a Clear left unused, and the rest of the block being allocated from.
+s64 PoolAllocator::Trim()
+{
+	return this->blocks.Trim();
+}
+
 void PoolAllocator::Clear()
 {
 	this->blocks.Clear();
@@ -40,7 +62,7 @@ void PoolAllocator::Clear()
 
 void PoolAllocator::Free()
 {
-	// @TODO
+	this->blocks.Free();
 }
 
 }
@@ -0,0 +1,169 @@
+#include "ScratchAllocator.h"
+#include "ContextAllocator.h"
+#include "AllocationHeader.h"
+#include "Memory.h"
+#include "../Fiber.h"
+
+namespace mem
+{
+
+// Constant initialized, so there is nothing to set up when a thread starts. The arena of a thread that exits is leaked, but our threads
+// live as long as the process.
+ThreadLocal auto threadScratchArena = ScratchArena{};
+
+// A job can move to another worker while it is suspended, but it can't be suspended in the middle of an allocation, so the arena stays put
+// for the duration of the call.
+ScratchArena *RunningScratchArena()
+{
+	if (RunningFiber())
+	{
+		return &RunningFiber()->scratchArena;
+	}
+	return &threadScratchArena;
+}
+
+// Makes sure the arena is committed up to end. Fails if that's past the end of the reservation.
+bool CommitScratch(ScratchArena *a, u8 *end)
+{
+	if (end <= a->committed)
+	{
+		return true;
+	}
+	if (end > a->buffer + ScratchArenaReservedSize)
+	{
+		return false;
+	}
+	end = (u8 *)AlignPointer(end, ScratchArenaCommitSize);
+	if (end > a->buffer + ScratchArenaReservedSize)
+	{
+		end = a->buffer + ScratchArenaReservedSize;
+	}
+	PlatformCommit(a->committed, end - a->committed);
+	a->committed = end;
+	return true;
+}
+
+void *AllocateScratch(ScratchArena *a, s64 size, s64 align)
+{
+	if (!a->buffer)
+	{
+		a->buffer = (u8 *)PlatformReserve(ScratchArenaReservedSize);
+		a->head = a->buffer;
+		a->committed = a->buffer;
+	}
+	auto maxSize = sizeof(AllocationHeader) + alignof(AllocationHeader) + align + size;
+	if (!CommitScratch(a, a->head + maxSize))
+	{
+		Abort("Memory", "Scratch arena ran out of space allocating %d bytes.", size);
+	}
+	auto mem = SetAllocationHeaderAndData(a->head, size, align);
+	a->last = mem;
+	a->head = mem + size;
+	return mem;
+}
+
+void *ScratchAllocator::Allocate(s64 size)
+{
+	return this->AllocateAligned(size, DefaultAlignment);
+}
+
+void *ScratchAllocator::AllocateAligned(s64 size, s64 align)
+{
+	return AllocateScratch(RunningScratchArena(), size, align);
+}
+
+void *ScratchAllocator::Resize(void *mem, s64 newSize)
+{
+	if (this->ResizeInPlace(mem, newSize))
+	{
+		return mem;
+	}
+	auto h = GetAllocationHeader(mem);
+	auto n = (newSize < h->size) ? newSize : h->size;
+	auto newMem = this->AllocateAligned(newSize, h->alignment);
+	arr::Copy(arr::NewView((u8 *)mem, n), arr::NewView((u8 *)newMem, n));
+	return newMem;
+}
+
+bool ScratchAllocator::ResizeInPlace(void *mem, s64 newSize)
+{
+	auto a = RunningScratchArena();
+	auto h = GetAllocationHeader(mem);
+	if (mem != a->last || !CommitScratch(a, (u8 *)mem + newSize))
+	{
+		return newSize <= h->size;
+	}
+	h->size = newSize;
+	a->head = (u8 *)mem + newSize;
+	return true;
+}
+
+// Only the most recent allocation can be given back. Everything else waits for its scope to end.
+void ScratchAllocator::Deallocate(void *mem)
+{
+	auto a = RunningScratchArena();
+	if (mem && mem == a->last)
+	{
+		a->head = (u8 *)GetAllocationHeader(mem);
+		a->last = NULL;
+	}
+}
+
+void ScratchAllocator::Clear()
+{
+	auto a = RunningScratchArena();
+	a->head = a->buffer;
+	a->last = NULL;
+}
+
+void ScratchAllocator::Free()
+{
+	FreeScratchArena(RunningScratchArena());
+}
+
+struct ScratchAllocator *ScratchAllocator()
+{
+	static auto a = (struct ScratchAllocator){};
+	return &a;
+}
+
+ScratchMark MarkScratch()
+{
+	auto a = RunningScratchArena();
+	return
+	{
+		.arena = a,
+		.head = a->head,
+		.last = a->last,
+	};
+}
+
+void RewindScratch(ScratchMark m)
+{
+	Assert(m.arena == RunningScratchArena());
+	m.arena->head = m.head;
+	m.arena->last = m.last;
+}
+
+void FreeScratchArena(ScratchArena *a)
+{
+	if (a->buffer)
+	{
+		PlatformDeallocate(a->buffer, ScratchArenaReservedSize);
+	}
+	*a = {};
+}
+
+ScratchScope::ScratchScope()
+{
+	this->mark = MarkScratch();
+	PushContextAllocator(ScratchAllocator());
+}
+
+ScratchScope::~ScratchScope()
+{
+	PopContextAllocator();
+	RewindScratch(this->mark);
+}
+
+}
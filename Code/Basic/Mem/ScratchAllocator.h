@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Allocator.h"
+
+namespace mem
+{
+
+// Scratch memory for temporaries, like strings being formatted and paths being built. Every fiber has its own scratch arena, and so does
+// every thread while it isn't running a fiber, so a job's scratch memory goes with it when it moves to another worker. Allocating bumps a
+// pointer and freeing does nothing unless it's the most recent allocation. Everything allocated inside a ScratchScope is freed when the
+// scope ends:
+//
+//	{
+//		auto scratch = mem::ScratchScope{};
+//		auto p = JoinFilepaths(dir, name); // Allocated from the scratch arena.
+//		paths.Append(p.CopyIn(mem::GlobalHeap()));
+//	}
+//
+// Scratch memory can't outlive its scope, so copy anything that has to be kept into another allocator before the scope ends.
+
+const auto ScratchArenaReservedSize = 64 * Megabyte;
+const auto ScratchArenaCommitSize = 64 * Kilobyte; // Pages are committed this many bytes at a time as the arena grows.
+
+struct ScratchArena
+{
+	u8 *buffer; // Reserved the first time the arena is used.
+	u8 *head;
+	u8 *last; // The most recent allocation, the only one that can be resized in place or freed.
+	u8 *committed;
+};
+
+struct ScratchMark
+{
+	ScratchArena *arena;
+	u8 *head;
+	u8 *last;
+};
+
+// Allocates from whichever scratch arena belongs to the running fiber at the time of the call.
+struct ScratchAllocator : Allocator
+{
+	void *Allocate(s64 size);
+	void *AllocateAligned(s64 size, s64 align);
+	void *Resize(void *mem, s64 newSize);
+	bool ResizeInPlace(void *mem, s64 newSize);
+	void Deallocate(void *mem);
+	void Clear();
+	void Free();
+};
+
+// Pushes the scratch allocator as the context allocator until the end of the C++ scope, then rewinds the scratch arena to where it was when
+// the scope started. Scopes nest.
+struct ScratchScope
+{
+	ScratchMark mark;
+
+	ScratchScope();
+	~ScratchScope();
+};
+
+struct ScratchAllocator *ScratchAllocator();
+ScratchArena *RunningScratchArena();
+ScratchMark MarkScratch();
+void RewindScratch(ScratchMark m);
+void FreeScratchArena(ScratchArena *a);
+
+}
@@ -35,11 +35,22 @@ void *SlotAllocator::Resize(void *mem, s64 newSize)
 	return NULL;
 }
 
+bool SlotAllocator::ResizeInPlace(void *mem, s64 newSize)
+{
+	return newSize <= this->slotSize;
+}
+
 void SlotAllocator::Deallocate(void *mem)
 {
 	this->freeSlots.Append(mem);
 }
 
+// Free slots are scattered through the blocks, so only the memory that was never handed out can be decommitted.
+s64 SlotAllocator::Trim()
+{
+	return this->blocks.Trim();
+}
+
 void SlotAllocator::Clear()
 {
 	this->blocks.Clear();
@@ -48,8 +59,8 @@ void SlotAllocator::Clear()
 
 void SlotAllocator::Free()
 {
-	// @TODO
-	this->freeSlots.Resize(0);
+	this->blocks.Free();
+	this->freeSlots.Free();
 }
 
 }
@@ -16,7 +16,9 @@ struct SlotAllocator : Allocator
 	void *Allocate(s64 size);
 	void *AllocateAligned(s64 size, s64 align);
 	void *Resize(void *mem, s64 newSize);
+	bool ResizeInPlace(void *mem, s64 newSize);
 	void Deallocate(void *mem);
+	s64 Trim();
 	void Clear();
 	void Free();
 };
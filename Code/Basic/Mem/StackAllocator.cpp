@@ -16,6 +16,7 @@ void *StackAllocator::AllocateWithHeader(s64 size, s64 align)
 	{
 		Abort("Memory", "Stack allocator ran out of space.");
 	}
+	this->last = mem;
 	return mem;
 }
 
@@ -26,7 +27,33 @@ void *StackAllocator::AllocateAligned(s64 size, s64 align)
 
 void *StackAllocator::Resize(void *mem, s64 newSize)
 {
-	return this->Allocate(newSize);
+	if (this->ResizeInPlace(mem, newSize))
+	{
+		return mem;
+	}
+	// We don't know how big the old allocation was, but it can't go past the head.
+	auto n = s64{};
+	if ((u8 *)mem >= this->buffer && (u8 *)mem < this->head)
+	{
+		n = this->head - (u8 *)mem;
+		if (n > newSize)
+		{
+			n = newSize;
+		}
+	}
+	auto newMem = this->Allocate(newSize);
+	arr::Copy(arr::NewView((u8 *)mem, n), arr::NewView((u8 *)newMem, n));
+	return newMem;
+}
+
+bool StackAllocator::ResizeInPlace(void *mem, s64 newSize)
+{
+	if (!mem || mem != this->last || ((u8 *)mem + newSize) - this->buffer > this->size)
+	{
+		return false;
+	}
+	this->head = (u8 *)mem + newSize;
+	return true;
 }
 
 void StackAllocator::Deallocate(void *mem)
@@ -36,6 +63,7 @@ void StackAllocator::Deallocate(void *mem)
 void StackAllocator::Clear()
 {
 	this->head = this->buffer;
+	this->last = NULL;
 }
 
 void StackAllocator::Free()
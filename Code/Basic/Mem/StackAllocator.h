@@ -10,12 +10,14 @@ struct StackAllocator : Allocator
 {
 	u8 *buffer;
 	u8 *head;
+	u8 *last; // The start of the most recent allocation, the only one that can be resized in place.
 	s64 size;
 
 	void *Allocate(s64 size);
 	void *AllocateWithHeader(s64 size, s64 align);
 	void *AllocateAligned(s64 size, s64 align);
 	void *Resize(void *mem, s64 newSize);
+	bool ResizeInPlace(void *mem, s64 newSize);
 	void Deallocate(void *mem);
 	void Clear();
 	void Free();
@@ -71,6 +71,65 @@ bool Spinlock::IsLocked()
 	return this->value == 1;
 }
 
+const auto ReadWriteSpinlockWriter = s64{1} << 62;
+
+void ReadWriteSpinlock::Lock()
+{
+	while (true)
+	{
+		auto v = this->value;
+		if (!(v & ReadWriteSpinlockWriter) && AtomicCompareAndSwap64(&this->value, v, v | ReadWriteSpinlockWriter) == v)
+		{
+			break;
+		}
+		CPUSpinWaitHint();
+	}
+	// Wait for the readers that got in before us to leave.
+	while (this->value != ReadWriteSpinlockWriter)
+	{
+		CPUSpinWaitHint();
+	}
+}
+
+void ReadWriteSpinlock::Unlock()
+{
+	AtomicAdd64(&this->value, -ReadWriteSpinlockWriter);
+}
+
+void ReadWriteSpinlock::LockShared()
+{
+	while (true)
+	{
+		auto v = this->value;
+		if (!(v & ReadWriteSpinlockWriter) && AtomicCompareAndSwap64(&this->value, v, v + 1) == v)
+		{
+			return;
+		}
+		CPUSpinWaitHint();
+	}
+}
+
+void ReadWriteSpinlock::UnlockShared()
+{
+	AtomicAdd64(&this->value, -1);
+}
+
+void FutexWait(volatile s32 *addr, s32 val)
+{
+	if (syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0) == -1 && errno != EAGAIN && errno != EINTR)
+	{
+		Abort("Thread", "Failed futex wait: %k.", PlatformError());
+	}
+}
+
+void FutexWake(volatile s32 *addr, s32 count)
+{
+	if (syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0) == -1)
+	{
+		Abort("Thread", "Failed futex wake: %k.", PlatformError());
+	}
+}
+
 ThreadLocal auto threadIndex = 0;
 auto threadCount = s64{1};
 
@@ -34,6 +34,23 @@ struct Spinlock
 	bool IsLocked();
 };
 
+// Any number of readers can hold the lock at once, or one writer. A writer that is waiting keeps new readers out, so a steady stream of
+// readers can't starve it.
+struct ReadWriteSpinlock
+{
+	volatile s64 value; // Reader count, plus ReadWriteSpinlockWriter while a writer holds or is waiting for the lock.
+
+	void Lock();
+	void Unlock();
+	void LockShared();
+	void UnlockShared();
+};
+
+// Sleeps until another thread calls FutexWake on addr, as long as *addr still equals val when the call is made. Can return spuriously, so
+// callers have to recheck their condition.
+void FutexWait(volatile s32 *addr, s32 val);
+void FutexWake(volatile s32 *addr, s32 count);
+
 #define ThreadLocal __thread
 
 typedef pthread_t Thread;
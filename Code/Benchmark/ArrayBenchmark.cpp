@@ -0,0 +1,104 @@
+#include "Benchmark.h"
+#include "Basic/Mem/GlobalHeap.h"
+#include "Basic/Container/Array.h"
+#include "Basic/Log.h"
+#include "Basic/Time/Time.h"
+
+// ArrayAppend: grows arrays one element at a time in the global heap, once letting growth resize the allocation in place and once forcing
+// every growth to allocate, copy and free. A single array can usually grow into the free memory after it. Arrays that grow in turns sit
+// next to each other, so they only grow in place once they are big enough to get a medium chunk or a mapping of their own.
+
+const auto DefaultArrayAppendCount = 16 * 1024 * 1024;
+
+// Forwards to the global heap and counts how growth went. With inPlace off, ResizeInPlace always fails, which is how every allocator
+// behaved before it existed.
+struct ArrayAppendAllocator : mem::Allocator
+{
+	bool inPlace;
+	s64 inPlaceCount;
+	s64 movedCount;
+
+	void *Allocate(s64 size);
+	void *AllocateAligned(s64 size, s64 align);
+	void *Resize(void *mem, s64 newSize);
+	bool ResizeInPlace(void *mem, s64 newSize);
+	void Deallocate(void *mem);
+	void Clear();
+	void Free();
+};
+
+void *ArrayAppendAllocator::Allocate(s64 size)
+{
+	return mem::GlobalHeap()->Allocate(size);
+}
+
+void *ArrayAppendAllocator::AllocateAligned(s64 size, s64 align)
+{
+	return mem::GlobalHeap()->AllocateAligned(size, align);
+}
+
+void *ArrayAppendAllocator::Resize(void *mem, s64 newSize)
+{
+	Abort("Benchmark", "Unsupported call to Resize in ArrayAppendAllocator.");
+	return NULL;
+}
+
+bool ArrayAppendAllocator::ResizeInPlace(void *mem, s64 newSize)
+{
+	if (this->inPlace && mem::GlobalHeap()->ResizeInPlace(mem, newSize))
+	{
+		this->inPlaceCount += 1;
+		return true;
+	}
+	this->movedCount += 1;
+	return false;
+}
+
+void ArrayAppendAllocator::Deallocate(void *mem)
+{
+	mem::GlobalHeap()->Deallocate(mem);
+}
+
+void ArrayAppendAllocator::Clear()
+{
+	Abort("Benchmark", "Unsupported call to Clear in ArrayAppendAllocator.");
+}
+
+void ArrayAppendAllocator::Free()
+{
+	Abort("Benchmark", "Unsupported call to Free in ArrayAppendAllocator.");
+}
+
+// Appends appendCount elements in total, spread round robin over arrayCount arrays.
+void RunArrayAppend(const char *name, bool inPlace, s64 arrayCount, s64 appendCount)
+{
+	auto a = ArrayAppendAllocator{};
+	a.inPlace = inPlace;
+	auto arrays = arr::NewIn<arr::array<s64>>(mem::GlobalHeap(), arrayCount);
+	for (auto &e : arrays)
+	{
+		e = arr::NewIn<s64>(&a, 0);
+	}
+	auto start = time::Now();
+	for (auto i = 0; i < appendCount; i += 1)
+	{
+		arrays[i % arrayCount].Append(i);
+	}
+	LogBenchmarkResult(name, appendCount, (time::Now() - start).Nanoseconds());
+	log::Info("Benchmark", "	%d growths in place, %d moved.", a.inPlaceCount, a.movedCount);
+	for (auto &e : arrays)
+	{
+		e.Free();
+	}
+	arrays.Free();
+}
+
+// Arguments: the number of elements to append.
+void ArrayAppendBenchmark(s64 argc, char **argv)
+{
+	auto n = BenchmarkArgument(argc, argv, 0, DefaultArrayAppendCount);
+	RunArrayAppend("One array, growing in place", true, 1, n);
+	RunArrayAppend("One array, always moving", false, 1, n);
+	RunArrayAppend("Four arrays in turns, growing in place", true, 4, n);
+	RunArrayAppend("Four arrays in turns, always moving", false, 4, n);
+}
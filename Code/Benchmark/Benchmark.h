@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Common.h"
+
+// Each benchmark is picked by name on the command line and gets the arguments that follow the name. Run them from an optimized release
+// build, for instance with Misc/Linux/Benchmark.
+
+typedef void (*BenchmarkProcedure)(s64 argc, char **argv);
+
+struct Benchmark
+{
+	const char *name;
+	const char *arguments;
+	BenchmarkProcedure procedure;
+};
+
+const auto MaxBenchmarkThreadCount = 256;
+
+typedef void (*BenchmarkThreadProcedure)(void *param, s64 threadIndex);
+
+s64 BenchmarkArgument(s64 argc, char **argv, s64 i, s64 fallback);
+void LogBenchmarkResult(const char *name, s64 operationCount, s64 nanoseconds);
+u64 BenchmarkRandomSeed(s64 i);
+u64 BenchmarkRandom(u64 *state);
+s64 ResidentBytes();
+u64 MapBenchmarkHash(u64 k);
+s64 RunBenchmarkThreads(s64 threadCount, BenchmarkThreadProcedure proc, void *param);
+
+void JobScalingBenchmark(s64 argc, char **argv);
+void FiberSwitchBenchmark(s64 argc, char **argv);
+void GlobalHeapContentionBenchmark(s64 argc, char **argv);
+void HeapStressBenchmark(s64 argc, char **argv);
+void ArrayAppendBenchmark(s64 argc, char **argv);
+void HugePageAccessBenchmark(s64 argc, char **argv);
+void SlotAllocatorContentionBenchmark(s64 argc, char **argv);
+void MapOperationsBenchmark(s64 argc, char **argv);
+void ConcurrentMapMixBenchmark(s64 argc, char **argv);
+void QueueThroughputBenchmark(s64 argc, char **argv);
+void QueueLatencyBenchmark(s64 argc, char **argv);
@@ -0,0 +1,80 @@
+#include "Benchmark.h"
+#include "Basic/Thread.h"
+#include "Basic/Atomic.h"
+#include "Basic/CPU.h"
+#include "Basic/Log.h"
+#include "Basic/Time/Time.h"
+#include "Basic/Container/Array.h"
+
+// The threads are created once and reused by every run. Making new threads per run would keep raising ThreadIndex, and the allocators
+// only keep per-thread caches for low thread indices.
+struct BenchmarkThreadPool
+{
+	arr::Static<Semaphore, MaxBenchmarkThreadCount> startSignals;
+	arr::Static<s64, MaxBenchmarkThreadCount> indices;
+	s64 threadCount;
+	Semaphore finishSignal;
+	volatile s64 readyCount;
+	volatile s64 released; // Spun on by the ready threads, so they all start at once.
+	BenchmarkThreadProcedure procedure;
+	void *parameter;
+};
+
+auto benchmarkThreads = BenchmarkThreadPool
+{
+	.finishSignal = NewSemaphore(0),
+};
+
+void *RunBenchmarkThread(void *param)
+{
+	auto i = *(s64 *)param;
+	auto p = &benchmarkThreads;
+	while (true)
+	{
+		p->startSignals[i].Wait();
+		AtomicAdd64(&p->readyCount, 1);
+		while (!__atomic_load_n(&p->released, __ATOMIC_ACQUIRE))
+		{
+			CPUSpinWaitHint();
+		}
+		p->procedure(p->parameter, i);
+		p->finishSignal.Signal();
+	}
+	return NULL;
+}
+
+// Runs proc(param, i) on threadCount threads, with i from zero to threadCount - 1, and returns the nanoseconds between releasing the
+// threads and the last one finishing.
+s64 RunBenchmarkThreads(s64 threadCount, BenchmarkThreadProcedure proc, void *param)
+{
+	auto p = &benchmarkThreads;
+	if (threadCount < 1 || threadCount > MaxBenchmarkThreadCount)
+	{
+		Abort("Benchmark", "Thread count %d is out of range, the most is %d.", threadCount, MaxBenchmarkThreadCount);
+	}
+	for (; p->threadCount < threadCount; p->threadCount += 1)
+	{
+		p->startSignals[p->threadCount] = NewSemaphore(0);
+		p->indices[p->threadCount] = p->threadCount;
+		NewThread(RunBenchmarkThread, &p->indices[p->threadCount]);
+	}
+	p->procedure = proc;
+	p->parameter = param;
+	p->readyCount = 0;
+	__atomic_store_n(&p->released, 0, __ATOMIC_RELEASE);
+	for (auto i = 0; i < threadCount; i += 1)
+	{
+		p->startSignals[i].Signal();
+	}
+	while (__atomic_load_n(&p->readyCount, __ATOMIC_ACQUIRE) < threadCount)
+	{
+		CPUSpinWaitHint();
+	}
+	auto start = time::Now();
+	__atomic_store_n(&p->released, 1, __ATOMIC_RELEASE);
+	for (auto i = 0; i < threadCount; i += 1)
+	{
+		p->finishSignal.Wait();
+	}
+	return (time::Now() - start).Nanoseconds();
+}
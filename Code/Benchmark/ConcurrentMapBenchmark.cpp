@@ -0,0 +1,155 @@
+#include "Benchmark.h"
+#include "Engine/Job.h"
+#include "Basic/Container/Map.h"
+#include "Basic/Mem/GlobalHeap.h"
+#include "Basic/Thread.h"
+#include "Basic/Atomic.h"
+#include "Basic/Log.h"
+
+// ConcurrentMapMix: every thread looks up, inserts and removes random keys in one shared map, with a fixed percentage of the operations
+// being lookups. Half of the lookups hit. Each mix runs against the sharded concurrent map and against a single map behind one
+// reader-writer lock, which is what a registry gets if it just wraps its map in a lock.
+
+const auto ConcurrentMapBenchmarkKeyCount = 64 * 1024;
+const auto DefaultConcurrentMapOperationCount = 1000 * 1000;
+
+enum ConcurrentMapMode
+{
+	ShardedConcurrentMap,
+	LockedConcurrentMap,
+};
+
+struct LockedMap
+{
+	ReadWriteSpinlock lock;
+	map<u64, u64> map;
+};
+
+struct ConcurrentMapMix
+{
+	ConcurrentMapMode mode;
+	s64 readPercent;
+	s64 operationCount;
+	concurrentMap<u64, u64> *shardedMap;
+	LockedMap *lockedMap;
+	volatile s64 hitCount;
+};
+
+bool ConcurrentMapMixLookup(ConcurrentMapMix *m, u64 k, u64 *v)
+{
+	if (m->mode == ShardedConcurrentMap)
+	{
+		return m->shardedMap->Lookup(k, v);
+	}
+	m->lockedMap->lock.LockShared();
+	auto p = m->lockedMap->map.Lookup(k);
+	if (p)
+	{
+		*v = *p;
+	}
+	m->lockedMap->lock.UnlockShared();
+	return p != NULL;
+}
+
+void ConcurrentMapMixInsert(ConcurrentMapMix *m, u64 k, u64 v)
+{
+	if (m->mode == ShardedConcurrentMap)
+	{
+		m->shardedMap->Insert(k, v);
+		return;
+	}
+	m->lockedMap->lock.Lock();
+	m->lockedMap->map.Insert(k, v);
+	m->lockedMap->lock.Unlock();
+}
+
+void ConcurrentMapMixRemove(ConcurrentMapMix *m, u64 k)
+{
+	if (m->mode == ShardedConcurrentMap)
+	{
+		m->shardedMap->Remove(k);
+		return;
+	}
+	m->lockedMap->lock.Lock();
+	m->lockedMap->map.Remove(k);
+	m->lockedMap->lock.Unlock();
+}
+
+void RunConcurrentMapMix(void *param, s64 threadIndex)
+{
+	auto m = (ConcurrentMapMix *)param;
+	auto random = BenchmarkRandomSeed(threadIndex);
+	auto hits = s64{0};
+	for (auto i = 0; i < m->operationCount; i += 1)
+	{
+		auto r = BenchmarkRandom(&random);
+		// Keys come from twice the range that is filled at the start, so about half of them are in the map at any time.
+		auto k = (r >> 8) % (2 * ConcurrentMapBenchmarkKeyCount);
+		if ((s64)(r % 100) < m->readPercent)
+		{
+			auto v = u64{};
+			hits += ConcurrentMapMixLookup(m, k, &v);
+		}
+		else if (r & 0x80)
+		{
+			ConcurrentMapMixInsert(m, k, i);
+		}
+		else
+		{
+			ConcurrentMapMixRemove(m, k);
+		}
+	}
+	AtomicAdd64(&m->hitCount, hits);
+}
+
+// Arguments: the number of threads, which defaults to one per job worker, and the operations per thread.
+void ConcurrentMapMixBenchmark(s64 argc, char **argv)
+{
+	auto threadCount = BenchmarkArgument(argc, argv, 0, WorkerThreadCount());
+	auto operationCount = BenchmarkArgument(argc, argv, 1, DefaultConcurrentMapOperationCount);
+	log::Info("Benchmark", "Concurrent map operations on %d threads.", threadCount);
+	const struct
+	{
+		const char *name;
+		ConcurrentMapMode mode;
+		s64 readPercent;
+	} cases[] =
+	{
+		{"Sharded map, 99% lookups", ShardedConcurrentMap, 99},
+		{"One locked map, 99% lookups", LockedConcurrentMap, 99},
+		{"Sharded map, 90% lookups", ShardedConcurrentMap, 90},
+		{"One locked map, 90% lookups", LockedConcurrentMap, 90},
+		{"Sharded map, 50% lookups", ShardedConcurrentMap, 50},
+		{"One locked map, 50% lookups", LockedConcurrentMap, 50},
+	};
+	for (auto &c : cases)
+	{
+		auto shardedMap = NewConcurrentMapIn<u64, u64>(mem::GlobalHeap(), 2 * ConcurrentMapBenchmarkKeyCount, MapBenchmarkHash);
+		auto lockedMap = LockedMap
+		{
+			.map = NewMapIn<u64, u64>(mem::GlobalHeap(), 2 * ConcurrentMapBenchmarkKeyCount, MapBenchmarkHash),
+		};
+		for (auto k = 0; k < ConcurrentMapBenchmarkKeyCount; k += 1)
+		{
+			shardedMap.Insert(2 * k, k);
+			lockedMap.map.Insert(2 * k, k);
+		}
+		auto m = ConcurrentMapMix
+		{
+			.mode = c.mode,
+			.readPercent = c.readPercent,
+			.operationCount = operationCount,
+			.shardedMap = &shardedMap,
+			.lockedMap = &lockedMap,
+		};
+		LogBenchmarkResult(c.name, threadCount * operationCount, RunBenchmarkThreads(threadCount, RunConcurrentMapMix, &m));
+		log::Info("Benchmark", "	%d lookup hits.", m.hitCount);
+		for (auto &s : shardedMap.shards)
+		{
+			s.map.controls.Free();
+			s.map.buckets.Free();
+		}
+		lockedMap.map.controls.Free();
+		lockedMap.map.buckets.Free();
+	}
+}
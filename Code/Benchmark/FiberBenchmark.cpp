@@ -0,0 +1,88 @@
+#include "Benchmark.h"
+#include "Basic/Fiber.h"
+#include "Basic/Memory.h"
+#include "Basic/Log.h"
+#include "Basic/Time/Time.h"
+#include <ucontext.h>
+
+// Measures the cost of a fiber context switch by bouncing between the thread's fiber and a second fiber. The same ping-pong is also run
+// with swapcontext, which saves the whole signal mask and FPU state and makes a syscall every switch, for comparison. Build the
+// UContextFiber configuration to measure the ucontext fiber backend instead of the assembly one.
+
+const auto DefaultFiberSwitchCount = 10 * 1000 * 1000;
+
+struct FiberPingPong
+{
+	fiber::Fiber *thread;
+	s64 switchCount;
+};
+
+void FiberPingPongProcedure(void *param)
+{
+	auto p = (FiberPingPong *)param;
+	while (true)
+	{
+		p->switchCount += 1;
+		p->thread->Switch();
+	}
+}
+
+struct UContextPingPong
+{
+	ucontext_t thread;
+	ucontext_t partner;
+	s64 switchCount;
+};
+
+UContextPingPong uContextPingPong;
+
+void UContextPingPongProcedure()
+{
+	while (true)
+	{
+		uContextPingPong.switchCount += 1;
+		swapcontext(&uContextPingPong.partner, &uContextPingPong.thread);
+	}
+}
+
+// Arguments: the number of round trips, each of which is two switches.
+void FiberSwitchBenchmark(s64 argc, char **argv)
+{
+	auto n = BenchmarkArgument(argc, argv, 0, DefaultFiberSwitchCount);
+
+	auto thread = fiber::Fiber{};
+	fiber::ConvertThread(&thread);
+	auto p = FiberPingPong
+	{
+		.thread = &thread,
+	};
+	auto partner = fiber::New(FiberPingPongProcedure, &p);
+	// The first switch runs into the new fiber's entry point, so keep it out of the timing.
+	partner.Switch();
+	auto start = time::Now();
+	for (auto i = 0; i < n; i += 1)
+	{
+		partner.Switch();
+	}
+	LogBenchmarkResult("Fiber switches", 2 * n, (time::Now() - start).Nanoseconds());
+	if (p.switchCount != n + 1)
+	{
+		Abort("Benchmark", "Expected %d fiber round trips, got %d.", n + 1, p.switchCount);
+	}
+
+	auto stackSize = fiber::DefaultStackSize();
+	auto stack = (u8 *)mem::PlatformAllocate(stackSize);
+	getcontext(&uContextPingPong.partner);
+	uContextPingPong.partner.uc_stack.ss_sp = stack;
+	uContextPingPong.partner.uc_stack.ss_size = stackSize;
+	uContextPingPong.partner.uc_link = NULL;
+	makecontext(&uContextPingPong.partner, UContextPingPongProcedure, 0);
+	swapcontext(&uContextPingPong.thread, &uContextPingPong.partner);
+	start = time::Now();
+	for (auto i = 0; i < n; i += 1)
+	{
+		swapcontext(&uContextPingPong.thread, &uContextPingPong.partner);
+	}
+	LogBenchmarkResult("swapcontext switches", 2 * n, (time::Now() - start).Nanoseconds());
+	mem::PlatformDeallocate(stack, stackSize);
+}
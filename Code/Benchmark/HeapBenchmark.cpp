@@ -0,0 +1,295 @@
+#include "Benchmark.h"
+#include "Basic/Mem/GlobalHeap.h"
+#include "Basic/Mem/HeapAllocator.h"
+#include "Basic/CPU.h"
+#include "Basic/Log.h"
+#include "Basic/Assert.h"
+#include "Basic/Process.h"
+#include "Basic/Time/Time.h"
+
+// GlobalHeapContention: every thread keeps a window of small allocations and keeps replacing a random one with a new allocation of a
+// random size, so each operation is one allocation and one free. The same churn runs through the global heap's magazines, through the
+// global heap's lock the way every small allocation went before the magazines, and through malloc.
+
+const auto HeapChurnWindowSize = 64;
+const auto DefaultHeapChurnOperationCount = 1000 * 1000;
+
+enum HeapChurnMode
+{
+	MagazineHeapChurn,
+	LockedHeapChurn,
+	MallocHeapChurn,
+};
+
+struct HeapChurn
+{
+	HeapChurnMode mode;
+	s64 operationCount;
+};
+
+void *HeapChurnAllocate(HeapChurnMode m, s64 size)
+{
+	switch (m)
+	{
+	case MagazineHeapChurn:
+	{
+		return mem::GlobalHeap()->Allocate(size);
+	} break;
+	case LockedHeapChurn:
+	{
+		auto h = mem::GlobalHeap();
+		h->lock.Lock();
+		auto p = h->heap.Allocate(size);
+		h->lock.Unlock();
+		return p;
+	} break;
+	case MallocHeapChurn:
+	{
+		return malloc(size);
+	} break;
+	}
+	return NULL;
+}
+
+void HeapChurnDeallocate(HeapChurnMode m, void *p)
+{
+	switch (m)
+	{
+	case MagazineHeapChurn:
+	{
+		mem::GlobalHeap()->Deallocate(p);
+	} break;
+	case LockedHeapChurn:
+	{
+		auto h = mem::GlobalHeap();
+		h->lock.Lock();
+		h->heap.Deallocate(p);
+		h->lock.Unlock();
+	} break;
+	case MallocHeapChurn:
+	{
+		free(p);
+	} break;
+	}
+}
+
+void RunHeapChurn(void *param, s64 threadIndex)
+{
+	auto c = (HeapChurn *)param;
+	auto random = BenchmarkRandomSeed(threadIndex);
+	void *window[HeapChurnWindowSize];
+	for (auto &p : window)
+	{
+		p = HeapChurnAllocate(c->mode, 1 + BenchmarkRandom(&random) % mem::HeapMaxSmallSize);
+	}
+	for (auto i = 0; i < c->operationCount; i += 1)
+	{
+		auto r = BenchmarkRandom(&random);
+		auto w = &window[r % HeapChurnWindowSize];
+		HeapChurnDeallocate(c->mode, *w);
+		*w = HeapChurnAllocate(c->mode, 1 + (r >> 32) % mem::HeapMaxSmallSize);
+		// Write to the new block like a real caller would.
+		*(u8 *)*w = (u8)i;
+	}
+	for (auto p : window)
+	{
+		HeapChurnDeallocate(c->mode, p);
+	}
+}
+
+// Arguments: the number of threads, which defaults to one per processor, and the operations per thread.
+void GlobalHeapContentionBenchmark(s64 argc, char **argv)
+{
+	auto threadCount = BenchmarkArgument(argc, argv, 0, CPUProcessorCount());
+	auto operationCount = BenchmarkArgument(argc, argv, 1, DefaultHeapChurnOperationCount);
+	log::Info("Benchmark", "Small allocation churn on %d threads.", threadCount);
+	const struct
+	{
+		const char *name;
+		HeapChurnMode mode;
+	} modes[] =
+	{
+		{"Global heap with magazines", MagazineHeapChurn},
+		{"Global heap behind its lock", LockedHeapChurn},
+		{"malloc", MallocHeapChurn},
+	};
+	for (auto &m : modes)
+	{
+		auto c = HeapChurn
+		{
+			.mode = m.mode,
+			.operationCount = operationCount,
+		};
+		// Warm up the magazines and free lists first.
+		RunBenchmarkThreads(threadCount, RunHeapChurn, &c);
+		LogBenchmarkResult(m.name, threadCount * operationCount, RunBenchmarkThreads(threadCount, RunHeapChurn, &c));
+	}
+}
+
+// HeapStress: keeps a table of live allocations in a standalone heap and keeps replacing random ones with allocations of random sizes,
+// mostly small, some medium, and a few big enough to be mapped on their own. Every allocation is filled with a pattern that is checked when
+// it is freed, so a heap that hands out overlapping memory fails right away. The resident set size is logged after every round. A heap
+// that reuses freed memory levels off after the first few rounds, while one that leaks grows every round until it runs out.
+
+const auto HeapStressBlockSize = 8 * Megabyte;
+const auto DefaultHeapStressRoundCount = 20;
+const auto DefaultHeapStressLiveCount = 1024;
+// The stress fails if the resident set grows by more than this factor between the first round and the last one.
+const auto HeapStressMaxGrowth = 2;
+
+// Gives the stressed heap blocks straight from the OS, so they aren't mixed up with the global heap's memory.
+struct HeapStressBlockAllocator : mem::Allocator
+{
+	void *Allocate(s64 size);
+	void *AllocateAligned(s64 size, s64 align);
+	void *Resize(void *mem, s64 size);
+	bool ResizeInPlace(void *mem, s64 newSize);
+	void Deallocate(void *mem);
+	void Clear();
+	void Free();
+};
+
+void *HeapStressBlockAllocator::Allocate(s64 size)
+{
+	Assert(size == HeapStressBlockSize);
+	return mem::PlatformAllocate(size);
+}
+
+void *HeapStressBlockAllocator::AllocateAligned(s64 size, s64 align)
+{
+	Abort("Benchmark", "Unsupported call to AllocateAligned in HeapStressBlockAllocator.");
+	return NULL;
+}
+
+void *HeapStressBlockAllocator::Resize(void *mem, s64 newSize)
+{
+	Abort("Benchmark", "Unsupported call to Resize in HeapStressBlockAllocator.");
+	return NULL;
+}
+
+bool HeapStressBlockAllocator::ResizeInPlace(void *mem, s64 newSize)
+{
+	Abort("Benchmark", "Unsupported call to ResizeInPlace in HeapStressBlockAllocator.");
+	return false;
+}
+
+void HeapStressBlockAllocator::Deallocate(void *mem)
+{
+	mem::PlatformDeallocate(mem, HeapStressBlockSize);
+}
+
+void HeapStressBlockAllocator::Clear()
+{
+	Abort("Benchmark", "Unsupported call to Clear in HeapStressBlockAllocator.");
+}
+
+void HeapStressBlockAllocator::Free()
+{
+	Abort("Benchmark", "Unsupported call to Free in HeapStressBlockAllocator.");
+}
+
+struct HeapStressAllocation
+{
+	u8 *memory;
+	s64 size;
+	u8 pattern;
+};
+
+s64 HeapStressSize(u64 *random, s64 maxMediumSize)
+{
+	auto r = BenchmarkRandom(random);
+	auto kind = r % 100;
+	r >>= 8;
+	if (kind < 70)
+	{
+		return 1 + r % mem::HeapMaxSmallSize;
+	}
+	if (kind < 97)
+	{
+		// Spread evenly over the powers of two, so most medium allocations are on the small side, like in a real program.
+		auto low = mem::HeapMaxSmallSize << (r % 10);
+		auto size = low + 1 + (r >> 4) % low;
+		return (size < maxMediumSize) ? size : maxMediumSize;
+	}
+	return maxMediumSize + 1 + r % (2 * maxMediumSize);
+}
+
+void FillHeapStressAllocation(HeapStressAllocation *a)
+{
+	memset(a->memory, a->pattern, a->size);
+}
+
+void CheckHeapStressAllocation(HeapStressAllocation *a)
+{
+	// Checking every byte would swamp the heap operations, so check the ends and a few bytes in between.
+	for (auto i = s64{0}; i < a->size; i += 1 + a->size / 16)
+	{
+		if (a->memory[i] != a->pattern)
+		{
+			Abort("Benchmark", "Heap allocation of %d bytes was overwritten at byte %d.", a->size, i);
+		}
+	}
+	if (a->memory[a->size - 1] != a->pattern)
+	{
+		Abort("Benchmark", "Heap allocation of %d bytes was overwritten at its last byte.", a->size);
+	}
+}
+
+// Arguments: the number of rounds, and the number of live allocations. Every round replaces four times as many allocations as are live.
+void HeapStressBenchmark(s64 argc, char **argv)
+{
+	auto roundCount = BenchmarkArgument(argc, argv, 0, DefaultHeapStressRoundCount);
+	auto liveCount = BenchmarkArgument(argc, argv, 1, DefaultHeapStressLiveCount);
+	auto blockAlloc = HeapStressBlockAllocator{};
+	auto heap = mem::NewHeapAllocator(HeapStressBlockSize, 0, &blockAlloc, mem::GlobalHeap());
+	auto live = arr::NewIn<HeapStressAllocation>(mem::GlobalHeap(), liveCount);
+	auto random = BenchmarkRandomSeed(0);
+	for (auto &a : live)
+	{
+		a.size = HeapStressSize(&random, heap.maxMediumSize);
+		a.memory = (u8 *)heap.Allocate(a.size);
+		a.pattern = (u8)BenchmarkRandom(&random);
+		FillHeapStressAllocation(&a);
+	}
+	auto startResident = ResidentBytes();
+	auto firstRoundResident = s64{0};
+	auto totalNanoseconds = s64{0};
+	for (auto round = 0; round < roundCount; round += 1)
+	{
+		auto start = time::Now();
+		for (auto i = 0; i < 4 * liveCount; i += 1)
+		{
+			auto a = &live[BenchmarkRandom(&random) % liveCount];
+			CheckHeapStressAllocation(a);
+			heap.Deallocate(a->memory);
+			a->size = HeapStressSize(&random, heap.maxMediumSize);
+			a->memory = (u8 *)heap.Allocate(a->size);
+			a->pattern = (u8)BenchmarkRandom(&random);
+			FillHeapStressAllocation(a);
+		}
+		totalNanoseconds += (time::Now() - start).Nanoseconds();
+		auto resident = ResidentBytes();
+		if (round == 0)
+		{
+			firstRoundResident = resident;
+		}
+		log::Info("Benchmark", "Round %d: %d bytes resident, %d heap blocks.", round, resident, heap.blocks.used.count);
+	}
+	// Includes filling and checking the memory, which costs more than the heap for the bigger sizes.
+	LogBenchmarkResult("Heap replacements", 4 * liveCount * roundCount, totalNanoseconds);
+	auto endResident = ResidentBytes();
+	for (auto &a : live)
+	{
+		CheckHeapStressAllocation(&a);
+		heap.Deallocate(a.memory);
+	}
+	auto trimmed = heap.Trim();
+	log::Info("Benchmark", "Resident bytes: %d at the start, %d after the first round, %d after the last round, %d after freeing everything and trimming %d bytes.", startResident, firstRoundResident, endResident, ResidentBytes(), trimmed);
+	heap.Free();
+	live.Free();
+	if (endResident > HeapStressMaxGrowth * firstRoundResident)
+	{
+		log::Error("Benchmark", "The resident set grew from %d to %d bytes. Freed heap memory isn't being reused.", firstRoundResident, endResident);
+		process::Exit(process::ExitStatus::Fail);
+	}
+}
@@ -0,0 +1,147 @@
+#include "Benchmark.h"
+#include "Engine/Job.h"
+#include "Engine/ParallelFor.h"
+#include "Engine/Math.h"
+#include "Basic/Log.h"
+#include "Basic/CPU.h"
+#include "Basic/Process.h"
+#include "Basic/Time/Time.h"
+#include "Basic/Container/Array.h"
+
+// Measures how the job system scales with the number of workers. The worker count is fixed once the job system starts, so run it once
+// per count:
+//
+//     for n in 1 2 4 8; do Misc/Linux/Benchmark JobScaling $n; done
+
+const auto JobBenchmarkRepeatCount = 5;
+const auto EmptyJobBatchSize = 1024;
+const auto EmptyJobCount = 1024 * 1024;
+const auto SpawnTreeDepth = 16;
+const auto ParallelForItemCount = 16 * 1024 * 1024;
+const auto ParallelForMinChunkSize = 4096;
+
+// Returns the fastest of a few runs of f, to keep out the noise from page faults and fiber pool growth in the first run.
+template <typename F>
+s64 BestJobBenchmarkNanoseconds(F f)
+{
+	auto best = s64{-1};
+	for (auto i = 0; i < JobBenchmarkRepeatCount; i += 1)
+	{
+		auto start = time::Now();
+		f();
+		auto ns = (time::Now() - start).Nanoseconds();
+		if (best < 0 || ns < best)
+		{
+			best = ns;
+		}
+	}
+	return best;
+}
+
+// Jobs run by each worker, so a run shows that every worker it was given really took part. Each worker only writes its own entry, and the
+// entries are padded so the counting doesn't add false sharing to what is being measured.
+struct JobScalingWorkerCount
+{
+	s64 jobCount;
+	u8 padding[CPUCacheLineSize - sizeof(s64)];
+};
+
+arr::Static<JobScalingWorkerCount, MaxBenchmarkThreadCount> jobScalingWorkerCounts;
+
+void CountJobScalingJob()
+{
+	jobScalingWorkerCounts[WorkerThreadIndex()].jobCount += 1;
+}
+
+void EmptyJob(void *)
+{
+	CountJobScalingJob();
+}
+
+// Splits into two child jobs down to depth zero and waits on them. Every job is pushed onto the deque of the worker that spawned it, so
+// the other workers only get work by stealing.
+void SpawnTreeJob(void *param)
+{
+	CountJobScalingJob();
+	auto depth = (s64)param;
+	if (depth == 0)
+	{
+		return;
+	}
+	JobDeclaration js[] =
+	{
+		NewJobDeclarationWithStackSize(SpawnTreeJob, (void *)(depth - 1), SmallJobStackSize),
+		NewJobDeclarationWithStackSize(SpawnTreeJob, (void *)(depth - 1), SmallJobStackSize),
+	};
+	auto c = (JobCounter *){};
+	RunJobs(arr::NewView(js, 2), RunningJobPriority(), &c);
+	c->Wait();
+	c->Free();
+}
+
+void RunJobScalingBenchmark(void *)
+{
+	log::Info("Benchmark", "Job scaling with %d workers.", WorkerThreadCount());
+
+	// Scheduling overhead: batches of jobs that do nothing.
+	auto jobs = arr::New<JobDeclaration>(EmptyJobBatchSize);
+	for (auto &j : jobs)
+	{
+		j = NewJobDeclarationWithStackSize(EmptyJob, NULL, SmallJobStackSize);
+	}
+	auto ns = BestJobBenchmarkNanoseconds([&jobs]()
+	{
+		for (auto i = 0; i < EmptyJobCount / EmptyJobBatchSize; i += 1)
+		{
+			auto c = (JobCounter *){};
+			RunJobs(jobs, HighJobPriority, &c);
+			c->Wait();
+			c->Free();
+		}
+	});
+	LogBenchmarkResult("Empty jobs", EmptyJobCount, ns);
+	jobs.Free();
+
+	// Work stealing: a binary tree of jobs that each wait on their children.
+	ns = BestJobBenchmarkNanoseconds([]()
+	{
+		SpawnTreeJob((void *)SpawnTreeDepth);
+	});
+	LogBenchmarkResult("Spawn tree jobs", (1 << (SpawnTreeDepth + 1)) - 2, ns);
+
+	// Compute-bound data parallelism, where more workers should mean close to proportionally more throughput.
+	auto values = arr::New<f32>(ParallelForItemCount);
+	ns = BestJobBenchmarkNanoseconds([&values]()
+	{
+		ParallelFor(ParallelForItemCount, ParallelForMinChunkSize, [&values](s64 i)
+		{
+			values[i] = sqrtf((f32)i) * sinf((f32)i);
+		});
+	});
+	LogBenchmarkResult("ParallelFor items", ParallelForItemCount, ns);
+	values.Free();
+
+	for (auto i = 0; i < WorkerThreadCount(); i += 1)
+	{
+		log::Info("Benchmark", "Worker %d ran %d empty and spawn tree jobs.", i, jobScalingWorkerCounts[i].jobCount);
+		if (jobScalingWorkerCounts[i].jobCount == 0)
+		{
+			log::Error("Benchmark", "Worker %d never ran a job, so these results don't reflect %d workers.", i, WorkerThreadCount());
+		}
+	}
+	auto s = JobSystemStatistics();
+	log::Info("Benchmark", "Workers spin-woke %d times and parked %d times, for %d ms in total.", s.spinWakeCount, s.parkCount, s.parkedNanoseconds / time::Millisecond);
+	process::Exit(process::ExitStatus::Success);
+}
+
+// Arguments: the number of workers, which defaults to one per processor.
+void JobScalingBenchmark(s64 argc, char **argv)
+{
+	auto workerCount = BenchmarkArgument(argc, argv, 0, WorkerThreadCount());
+	if (workerCount < 1 || workerCount > CPUProcessorCount() || workerCount > MaxBenchmarkThreadCount)
+	{
+		Abort("Benchmark", "Worker count %d is out of range, this machine has %d processors.", workerCount, CPUProcessorCount());
+	}
+	SetWorkerThreadCount(workerCount);
+	InitializeJobs(RunJobScalingBenchmark, NULL);
+}
@@ -0,0 +1,125 @@
+#include "Benchmark.h"
+#include "Basic/Log.h"
+#include "Basic/String.h"
+#include "Basic/Process.h"
+#include "Basic/CPU.h"
+
+const Benchmark benchmarks[] =
+{
+	{"JobScaling", "[workers]", JobScalingBenchmark},
+	{"FiberSwitch", "[round trips]", FiberSwitchBenchmark},
+	{"GlobalHeapContention", "[threads] [operations per thread]", GlobalHeapContentionBenchmark},
+	{"HeapStress", "[rounds] [live allocations]", HeapStressBenchmark},
+	{"ArrayAppend", "[elements]", ArrayAppendBenchmark},
+	{"HugePageAccess", "[megabytes] [loads]", HugePageAccessBenchmark},
+	{"SlotAllocatorContention", "[threads] [operations per thread]", SlotAllocatorContentionBenchmark},
+	{"MapOperations", "[keys]", MapOperationsBenchmark},
+	{"ConcurrentMapMix", "[threads] [operations per thread]", ConcurrentMapMixBenchmark},
+	{"QueueThroughput", "[producers] [consumers] [items]", QueueThroughputBenchmark},
+	{"QueueLatency", "[round trips]", QueueLatencyBenchmark},
+};
+
+// Returns argv[i] as an integer, or fallback if there is no such argument.
+s64 BenchmarkArgument(s64 argc, char **argv, s64 i, s64 fallback)
+{
+	if (i >= argc)
+	{
+		return fallback;
+	}
+	auto err = false;
+	auto n = str::ParseInt(str::Make(argv[i]), &err);
+	if (err)
+	{
+		Abort("Benchmark", "Expected an integer argument, got %s.", argv[i]);
+	}
+	return n;
+}
+
+// A different seed for every i, since xorshift needs a non-zero one.
+u64 BenchmarkRandomSeed(s64 i)
+{
+	return 0x9E3779B97F4A7C15ull * (i + 1);
+}
+
+// xorshift64. Cheap enough not to show up in the measurements.
+u64 BenchmarkRandom(u64 *state)
+{
+	auto x = *state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return x;
+}
+
+// A full 64-bit mix, so that both the low and the high bits of the hash depend on every bit of the key. Maps pick buckets from either end.
+u64 MapBenchmarkHash(u64 k)
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdull;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ull;
+	k ^= k >> 33;
+	return k;
+}
+
+// The process's resident set size, from the second field of /proc/self/statm.
+s64 ResidentBytes()
+{
+	auto fd = open("/proc/self/statm", O_RDONLY);
+	if (fd == -1)
+	{
+		Abort("Benchmark", "Failed to open /proc/self/statm: %k.", PlatformError());
+	}
+	char buffer[128];
+	auto n = read(fd, buffer, sizeof(buffer) - 1);
+	close(fd);
+	if (n <= 0)
+	{
+		Abort("Benchmark", "Failed to read /proc/self/statm: %k.", PlatformError());
+	}
+	buffer[n] = '\0';
+	auto p = buffer;
+	while (*p && *p != ' ')
+	{
+		p += 1;
+	}
+	return strtoll(p, NULL, 10) * CPUPageSize();
+}
+
+void LogBenchmarkResult(const char *name, s64 operationCount, s64 nanoseconds)
+{
+	auto perOperation = (f64)nanoseconds / (f64)operationCount;
+	auto perSecond = (f64)operationCount * 1e9 / (f64)nanoseconds;
+	log::Info("Benchmark", "%s: %d operations in %.2f ms, %.2f ns per operation, %.2f million per second.", name, operationCount, (f64)nanoseconds / 1e6, perOperation, perSecond / 1e6);
+}
+
+void LogUsage()
+{
+	log::Info("Benchmark", "Usage: Benchmark <name> [arguments]");
+	for (auto &b : benchmarks)
+	{
+		log::Info("Benchmark", "	%s %s", b.name, b.arguments);
+	}
+}
+
+s32 main(s32 argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		LogUsage();
+		process::Exit(process::ExitStatus::Fail);
+	}
+	for (auto &b : benchmarks)
+	{
+		if (str::Equal(argv[1], b.name))
+		{
+			b.procedure(argc - 2, argv + 2);
+			process::Exit(process::ExitStatus::Success);
+		}
+	}
+	log::Error("Benchmark", "Unknown benchmark %s.", argv[1]);
+	LogUsage();
+	process::Exit(process::ExitStatus::Fail);
+	return 1;
+}
@@ -0,0 +1,326 @@
+#include "Benchmark.h"
+#include "Basic/Container/Map.h"
+#include "Basic/Mem/GlobalHeap.h"
+#include "Basic/Log.h"
+#include "Basic/Assert.h"
+#include "Basic/Process.h"
+#include "Basic/Time/Time.h"
+
+// MapOperations: inserts random keys into a map, looks up every key that is in it, looks up as many keys that are not, then keeps removing
+// a random key and inserting a new one. Every case runs against the Swiss table map and against a copy of the linear probing map it
+// replaced, and the two maps have to agree on every result.
+
+const auto DefaultMapBenchmarkKeyCount = 1000 * 1000;
+// Keys that are inserted never have this bit set, so keys with it set are always misses.
+const auto MapBenchmarkMissBit = u64{1} << 63;
+
+volatile u64 mapBenchmarkSink;
+
+// The old map, as it was before the Swiss table, with the types renamed so they don't clash with the current ones. It hashes straight to
+// a bucket and probes linearly, keeping the full hash of every bucket in a separate array.
+
+const auto OldMapVacantHash = (u64)-1;
+const auto OldMapDeletedHash = (u64)-2;
+const auto OldMapMaxLoadFactor = 0.75f;
+
+template <typename K, typename V>
+struct oldMapKeyValue
+{
+	K key;
+	V value;
+};
+
+template <typename K, typename V>
+struct oldMap
+{
+	arr::array<u64> hashes;
+	arr::array<oldMapKeyValue<K, V>> buckets;
+	typedef u64 (*hashProcedure)(K);
+	hashProcedure hashProcedure;
+	s64 count;
+	f32 loadFactor;
+
+	void DoInsert(u64 hash, K k, V v);
+	void Insert(K k, V v);
+	V *Lookup(K k);
+	void Remove(K k);
+	void Reserve(s64 count);
+	void Free();
+};
+
+template <typename K, typename V>
+oldMap<K, V> NewOldMapIn(mem::Allocator *a, s64 cap, typename oldMap<K, V>::hashProcedure hp)
+{
+	auto m = oldMap<K, V>
+	{
+		.hashes = arr::NewIn<u64>(a, cap),
+		.buckets = arr::NewIn<oldMapKeyValue<K, V>>(a, cap),
+		.hashProcedure = hp,
+	};
+	for (auto &h : m.hashes)
+	{
+		h = OldMapVacantHash;
+	}
+	return m;
+}
+
+template <typename K, typename V>
+void oldMap<K, V>::DoInsert(u64 hash, K k, V v)
+{
+	if (hash == OldMapVacantHash)
+	{
+		hash = 0;
+	}
+	else if (hash == OldMapDeletedHash)
+	{
+		hash = 1;
+	}
+	auto i = hash % this->buckets.count;
+	auto end = i;
+	do
+	{
+		if (this->hashes[i] == OldMapVacantHash || (this->hashes[i] == hash && this->buckets[i].key == k))
+		{
+			this->hashes[i] = hash;
+			this->buckets[i].key = k;
+			this->buckets[i].value = v;
+			this->count += 1;
+			this->loadFactor = (f32)this->count / (f32)this->buckets.count;
+			return;
+		}
+		i = (i + 1) % this->buckets.count;
+		Assert(i != end);
+	} while (i != end);
+}
+
+template <typename K, typename V>
+void oldMap<K, V>::Insert(K k, V v)
+{
+	this->Reserve(this->count + 1);
+	this->DoInsert(this->hashProcedure(k), k, v);
+}
+
+template <typename K, typename V>
+V *oldMap<K, V>::Lookup(K k)
+{
+	if (this->buckets.count == 0)
+	{
+		return NULL;
+	}
+	auto hash = this->hashProcedure(k);
+	if (hash == OldMapVacantHash)
+	{
+		hash = 0;
+	}
+	else if (hash == OldMapDeletedHash)
+	{
+		hash = 1;
+	}
+	auto i = hash % this->buckets.count;
+	auto end = i;
+	do
+	{
+		if (this->hashes[i] == OldMapVacantHash)
+		{
+			return NULL;
+		}
+		else if (this->hashes[i] == hash && this->buckets[i].key == k)
+		{
+			return &this->buckets[i].value;
+		}
+		i = (i + 1) % this->buckets.count;
+	} while (i != end);
+	return NULL;
+}
+
+// The old map never implemented Remove, so this is the cheapest removal that fits its layout: backward shift deletion. Every entry after
+// the removed one in its probe run moves back into the hole unless that would put it before its home bucket, so lookups never need
+// tombstones.
+template <typename K, typename V>
+void oldMap<K, V>::Remove(K k)
+{
+	if (this->count == 0)
+	{
+		return;
+	}
+	auto hash = this->hashProcedure(k);
+	if (hash == OldMapVacantHash)
+	{
+		hash = 0;
+	}
+	else if (hash == OldMapDeletedHash)
+	{
+		hash = 1;
+	}
+	auto n = (u64)this->buckets.count;
+	auto i = hash % n;
+	while (this->hashes[i] != hash || this->buckets[i].key != k)
+	{
+		if (this->hashes[i] == OldMapVacantHash)
+		{
+			return;
+		}
+		i = (i + 1) % n;
+	}
+	for (auto j = (i + 1) % n; this->hashes[j] != OldMapVacantHash; j = (j + 1) % n)
+	{
+		// Leave the entry if its home bucket is cyclically in (i, j], since moving it to i would put it before its home.
+		auto home = this->hashes[j] % n;
+		if ((i <= j) ? (i < home && home <= j) : (i < home || home <= j))
+		{
+			continue;
+		}
+		this->hashes[i] = this->hashes[j];
+		this->buckets[i] = this->buckets[j];
+		i = j;
+	}
+	this->hashes[i] = OldMapVacantHash;
+	this->count -= 1;
+	this->loadFactor = (f32)this->count / (f32)this->buckets.count;
+}
+
+template <typename K, typename V>
+void oldMap<K, V>::Reserve(s64 reserve)
+{
+	if (this->buckets.count > reserve)
+	{
+		return;
+	}
+	if (this->buckets.count == 0)
+	{
+		this->hashes.Resize(reserve * 2);
+		for (auto &h : this->hashes)
+		{
+			h = OldMapVacantHash;
+		}
+		this->buckets.Resize(reserve * 2);
+		return;
+	}
+	if ((f32)reserve / (f32)this->buckets.count <= OldMapMaxLoadFactor)
+	{
+		return;
+	}
+	auto newMap = NewOldMapIn<K, V>(this->buckets.allocator, reserve * 2, this->hashProcedure);
+	for (auto i = 0; i < this->buckets.count; i += 1)
+	{
+		if (this->hashes[i] == OldMapVacantHash || this->hashes[i] == OldMapDeletedHash)
+		{
+			continue;
+		}
+		newMap.DoInsert(this->hashes[i], this->buckets[i].key, this->buckets[i].value);
+	}
+	// The old map leaked its arrays here. Free them, so both maps pay for giving memory back.
+	this->Free();
+	*this = newMap;
+}
+
+template <typename K, typename V>
+void oldMap<K, V>::Free()
+{
+	this->hashes.Free();
+	this->buckets.Free();
+}
+
+// Multiplying by an odd number is a bijection, so the i-th key is different for every i, and the keys still look random to the maps.
+u64 MapBenchmarkKey(s64 i)
+{
+	return ((u64)i * 0x9E3779B97F4A7C15ull) & ~MapBenchmarkMissBit;
+}
+
+enum MapBenchmarkCase
+{
+	MapBenchmarkInsert,
+	MapBenchmarkHit,
+	MapBenchmarkMiss,
+	MapBenchmarkChurn,
+	MapBenchmarkCaseCount,
+};
+
+const char *mapBenchmarkCaseNames[MapBenchmarkCaseCount] =
+{
+	"inserts",
+	"hit lookups",
+	"miss lookups",
+	"removes and inserts",
+};
+
+// Runs every case against one map and returns a checksum per case, so the two maps can be compared.
+template <typename M>
+void RunMapOperations(const char *mapName, M *m, arr::array<u64> keys, s64 churnCount, u64 checksums[MapBenchmarkCaseCount])
+{
+	log::Info("Benchmark", "%s:", mapName);
+	auto start = time::Now();
+	for (auto i = 0; i < keys.count; i += 1)
+	{
+		m->Insert(keys[i], i);
+	}
+	LogBenchmarkResult(mapBenchmarkCaseNames[MapBenchmarkInsert], keys.count, (time::Now() - start).Nanoseconds());
+	checksums[MapBenchmarkInsert] = m->count;
+	auto sum = u64{0};
+	start = time::Now();
+	for (auto k : keys)
+	{
+		sum += *m->Lookup(k);
+	}
+	LogBenchmarkResult(mapBenchmarkCaseNames[MapBenchmarkHit], keys.count, (time::Now() - start).Nanoseconds());
+	checksums[MapBenchmarkHit] = sum;
+	auto found = u64{0};
+	start = time::Now();
+	for (auto k : keys)
+	{
+		found += (m->Lookup(k | MapBenchmarkMissBit) != NULL);
+	}
+	LogBenchmarkResult(mapBenchmarkCaseNames[MapBenchmarkMiss], keys.count, (time::Now() - start).Nanoseconds());
+	checksums[MapBenchmarkMiss] = found;
+	// Replace a random live key with a new one, so the map stays the same size while its slots keep turning over. Both maps see the same
+	// sequence of keys.
+	auto live = arr::NewIn<u64>(mem::GlobalHeap(), keys.count);
+	for (auto i = 0; i < keys.count; i += 1)
+	{
+		live[i] = keys[i];
+	}
+	auto random = BenchmarkRandomSeed(1);
+	sum = 0;
+	start = time::Now();
+	for (auto i = 0; i < churnCount; i += 1)
+	{
+		auto k = &live[BenchmarkRandom(&random) % live.count];
+		m->Remove(*k);
+		*k = MapBenchmarkKey(keys.count + i);
+		m->Insert(*k, i);
+		sum += *m->Lookup(live[i % live.count]);
+	}
+	LogBenchmarkResult(mapBenchmarkCaseNames[MapBenchmarkChurn], churnCount, (time::Now() - start).Nanoseconds());
+	checksums[MapBenchmarkChurn] = sum + m->count;
+	live.Free();
+	mapBenchmarkSink = checksums[MapBenchmarkHit];
+}
+
+// Arguments: the number of keys. The remove and insert case runs four times as many operations as there are keys.
+void MapOperationsBenchmark(s64 argc, char **argv)
+{
+	auto keyCount = BenchmarkArgument(argc, argv, 0, DefaultMapBenchmarkKeyCount);
+	auto keys = arr::NewIn<u64>(mem::GlobalHeap(), keyCount);
+	for (auto i = 0; i < keyCount; i += 1)
+	{
+		keys[i] = MapBenchmarkKey(i);
+	}
+	u64 newChecksums[MapBenchmarkCaseCount];
+	u64 oldChecksums[MapBenchmarkCaseCount];
+	auto newMap = NewMapIn<u64, u64>(mem::GlobalHeap(), 0, MapBenchmarkHash);
+	RunMapOperations("Swiss table map", &newMap, keys, 4 * keyCount, newChecksums);
+	newMap.controls.Free();
+	newMap.buckets.Free();
+	auto old = NewOldMapIn<u64, u64>(mem::GlobalHeap(), 0, MapBenchmarkHash);
+	RunMapOperations("Linear probing map", &old, keys, 4 * keyCount, oldChecksums);
+	old.Free();
+	keys.Free();
+	for (auto c = 0; c < MapBenchmarkCaseCount; c += 1)
+	{
+		if (newChecksums[c] != oldChecksums[c])
+		{
+			log::Error("Benchmark", "The maps disagree on %s.", mapBenchmarkCaseNames[c]);
+			process::Exit(process::ExitStatus::Fail);
+		}
+	}
+}
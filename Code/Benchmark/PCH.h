@@ -0,0 +1,7 @@
+#pragma once
+
+#include "Basic/PCH.h"
+
+// Math
+#include <math.h>
+#include <float.h>
@@ -0,0 +1,84 @@
+#include "Benchmark.h"
+#include "Basic/Mem/Memory.h"
+#include "Basic/CPU.h"
+#include "Basic/Log.h"
+#include "Basic/Time/Time.h"
+
+// HugePageAccess: chases pointers through a buffer in random order, once with small pages and once with huge pages, when the system gives
+// us any. Every load depends on the one before it and lands on a random cache line, so with a buffer much bigger than the TLB covers,
+// nearly every load also needs a page walk. Huge pages cover 512 times as much memory per TLB entry, which is where the difference comes
+// from. Both buffers are prefaulted so that page faults stay out of the timing.
+
+const auto DefaultHugePageAccessMegabytes = 1024;
+const auto DefaultHugePageAccessCount = 20 * 1000 * 1000;
+
+volatile u64 hugePageAccessSink;
+
+const char *PageStrategyName(mem::PlatformPageStrategy s)
+{
+	switch (s)
+	{
+	case mem::PlatformSmallPages:
+	{
+		return "small pages";
+	} break;
+	case mem::PlatformExplicitHugePages:
+	{
+		return "explicit huge pages";
+	} break;
+	case mem::PlatformTransparentHugePages:
+	{
+		return "transparent huge pages";
+	} break;
+	case mem::PlatformPageStrategyCount:
+	default:
+	{
+		Abort("Benchmark", "Unknown page strategy %d.", s);
+	} break;
+	}
+	return NULL;
+}
+
+void RunHugePageAccess(const char *name, s64 flags, s64 size, s64 accessCount)
+{
+	auto strategy = mem::PlatformPageStrategy{};
+	auto buffer = (u8 *)mem::PlatformAllocateWithFlags(size, flags | mem::PlatformAllocatePrefault, &strategy);
+	// Link every cache line into one random cycle (Sattolo's algorithm). The first word of a line holds the index of the next line.
+	auto lineCount = size / CPUCacheLineSize;
+	auto Line = [buffer](u64 i)
+	{
+		return (u64 *)(buffer + i * CPUCacheLineSize);
+	};
+	for (auto i = u64{0}; i < lineCount; i += 1)
+	{
+		*Line(i) = i;
+	}
+	auto random = BenchmarkRandomSeed(0);
+	for (auto i = u64(lineCount - 1); i > 0; i -= 1)
+	{
+		auto j = BenchmarkRandom(&random) % i;
+		auto t = *Line(i);
+		*Line(i) = *Line(j);
+		*Line(j) = t;
+	}
+	auto line = u64{0};
+	auto start = time::Now();
+	for (auto i = 0; i < accessCount; i += 1)
+	{
+		line = *Line(line);
+	}
+	auto ns = (time::Now() - start).Nanoseconds();
+	hugePageAccessSink = line;
+	log::Info("Benchmark", "%s got %s.", name, PageStrategyName(strategy));
+	LogBenchmarkResult(name, accessCount, ns);
+	mem::PlatformDeallocate(buffer, size);
+}
+
+// Arguments: the buffer size in megabytes, and the number of loads.
+void HugePageAccessBenchmark(s64 argc, char **argv)
+{
+	auto size = BenchmarkArgument(argc, argv, 0, DefaultHugePageAccessMegabytes) * Megabyte;
+	auto accessCount = BenchmarkArgument(argc, argv, 1, DefaultHugePageAccessCount);
+	RunHugePageAccess("Small page loads", 0, size, accessCount);
+	RunHugePageAccess("Huge page loads", mem::PlatformAllocateHugePages, size, accessCount);
+}
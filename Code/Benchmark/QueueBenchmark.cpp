@@ -0,0 +1,317 @@
+#include "Benchmark.h"
+#include "Basic/Container/Queue.h"
+#include "Basic/Mem/GlobalHeap.h"
+#include "Basic/Thread.h"
+#include "Basic/Atomic.h"
+#include "Basic/CPU.h"
+#include "Basic/Log.h"
+#include "Basic/Process.h"
+
+// QueueThroughput: producer threads push numbered items as fast as they can while consumer threads pop them, one at a time and in batches.
+// Runs against the MPMC queue, the SPSC queue when there is one producer and one consumer, and a ring buffer behind a spinlock, which is
+// what the producers used before. Every item has to come out exactly once, which is checked with a sum.
+//
+// QueueLatency: two threads pass one item back and forth through a pair of queues, so each round trip is two pushes and two pops that the
+// other thread is waiting on.
+
+const auto QueueBenchmarkCapacity = 1024;
+const auto QueueBenchmarkBatchSize = 16;
+const auto DefaultQueueThroughputItemCount = 4 * 1000 * 1000;
+const auto DefaultQueueLatencyRoundTripCount = 1000 * 1000;
+
+enum QueueBenchmarkKind
+{
+	MPMCQueueBenchmark,
+	SPSCQueueBenchmark,
+	LockedQueueBenchmark,
+};
+
+struct LockedQueue
+{
+	Spinlock lock;
+	arr::array<u64> elements;
+	s64 head;
+	s64 tail;
+};
+
+struct BenchmarkQueue
+{
+	QueueBenchmarkKind kind;
+	queue::MPMC<u64> mpmc;
+	queue::SPSC<u64> spsc;
+	LockedQueue locked;
+};
+
+BenchmarkQueue NewBenchmarkQueue(QueueBenchmarkKind k)
+{
+	auto q = BenchmarkQueue
+	{
+		.kind = k,
+	};
+	switch (k)
+	{
+	case MPMCQueueBenchmark:
+	{
+		q.mpmc = queue::NewMPMCIn<u64>(mem::GlobalHeap(), QueueBenchmarkCapacity);
+	} break;
+	case SPSCQueueBenchmark:
+	{
+		q.spsc = queue::NewSPSCIn<u64>(mem::GlobalHeap(), QueueBenchmarkCapacity);
+	} break;
+	case LockedQueueBenchmark:
+	{
+		q.locked.elements = arr::NewIn<u64>(mem::GlobalHeap(), QueueBenchmarkCapacity);
+	} break;
+	}
+	return q;
+}
+
+void FreeBenchmarkQueue(BenchmarkQueue *q)
+{
+	switch (q->kind)
+	{
+	case MPMCQueueBenchmark:
+	{
+		q->mpmc.Free();
+	} break;
+	case SPSCQueueBenchmark:
+	{
+		q->spsc.Free();
+	} break;
+	case LockedQueueBenchmark:
+	{
+		q->locked.elements.Free();
+	} break;
+	}
+}
+
+s64 BenchmarkQueuePush(BenchmarkQueue *q, arr::view<u64> es)
+{
+	switch (q->kind)
+	{
+	case MPMCQueueBenchmark:
+	{
+		return q->mpmc.PushBatch(es);
+	} break;
+	case SPSCQueueBenchmark:
+	{
+		return q->spsc.PushBatch(es);
+	} break;
+	case LockedQueueBenchmark:
+	{
+		auto l = &q->locked;
+		l->lock.Lock();
+		auto n = l->elements.count - (l->tail - l->head);
+		n = (n < es.count) ? n : es.count;
+		for (auto i = 0; i < n; i += 1)
+		{
+			l->elements[(l->tail + i) % l->elements.count] = es[i];
+		}
+		l->tail += n;
+		l->lock.Unlock();
+		return n;
+	} break;
+	}
+	return 0;
+}
+
+s64 BenchmarkQueuePop(BenchmarkQueue *q, arr::view<u64> out)
+{
+	switch (q->kind)
+	{
+	case MPMCQueueBenchmark:
+	{
+		return q->mpmc.PopBatch(out);
+	} break;
+	case SPSCQueueBenchmark:
+	{
+		return q->spsc.PopBatch(out);
+	} break;
+	case LockedQueueBenchmark:
+	{
+		auto l = &q->locked;
+		l->lock.Lock();
+		auto n = l->tail - l->head;
+		n = (n < out.count) ? n : out.count;
+		for (auto i = 0; i < n; i += 1)
+		{
+			out[i] = l->elements[(l->head + i) % l->elements.count];
+		}
+		l->head += n;
+		l->lock.Unlock();
+		return n;
+	} break;
+	}
+	return 0;
+}
+
+struct QueueThroughput
+{
+	BenchmarkQueue queue;
+	s64 producerCount;
+	s64 itemsPerProducer;
+	s64 batchSize;
+	volatile s64 finishedProducerCount;
+	volatile s64 sum;
+};
+
+// The first producerCount threads produce and the rest consume. Producer p pushes the items j * producerCount + p + 1, so the items are
+// 1 through producerCount * itemsPerProducer, each pushed once.
+void RunQueueThroughput(void *param, s64 threadIndex)
+{
+	auto t = (QueueThroughput *)param;
+	u64 batch[QueueBenchmarkBatchSize];
+	if (threadIndex < t->producerCount)
+	{
+		for (auto j = 0; j < t->itemsPerProducer;)
+		{
+			auto n = 0;
+			for (; n < t->batchSize && j + n < t->itemsPerProducer; n += 1)
+			{
+				batch[n] = (j + n) * t->producerCount + threadIndex + 1;
+			}
+			for (auto pushed = 0; pushed < n;)
+			{
+				auto p = BenchmarkQueuePush(&t->queue, arr::NewView(&batch[pushed], n - pushed));
+				if (p == 0)
+				{
+					CPUSpinWaitHint();
+				}
+				pushed += p;
+			}
+			j += n;
+		}
+		AtomicAdd64(&t->finishedProducerCount, 1);
+		return;
+	}
+	auto sum = u64{0};
+	while (true)
+	{
+		// Read the producers' progress before popping. If they had all finished and the pop still comes back empty, every item has been
+		// taken.
+		auto finished = __atomic_load_n(&t->finishedProducerCount, __ATOMIC_ACQUIRE) == t->producerCount;
+		auto n = BenchmarkQueuePop(&t->queue, arr::NewView(batch, t->batchSize));
+		if (n == 0)
+		{
+			if (finished)
+			{
+				break;
+			}
+			CPUSpinWaitHint();
+			continue;
+		}
+		for (auto i = 0; i < n; i += 1)
+		{
+			sum += batch[i];
+		}
+	}
+	AtomicAdd64(&t->sum, sum);
+}
+
+void RunQueueThroughputCase(const char *name, QueueBenchmarkKind k, s64 producerCount, s64 consumerCount, s64 itemCount, s64 batchSize)
+{
+	auto t = QueueThroughput
+	{
+		.queue = NewBenchmarkQueue(k),
+		.producerCount = producerCount,
+		.itemsPerProducer = itemCount / producerCount,
+		.batchSize = batchSize,
+	};
+	auto total = t.itemsPerProducer * producerCount;
+	LogBenchmarkResult(name, total, RunBenchmarkThreads(producerCount + consumerCount, RunQueueThroughput, &t));
+	FreeBenchmarkQueue(&t.queue);
+	if ((u64)t.sum != (u64)total * (total + 1) / 2)
+	{
+		log::Error("Benchmark", "%s lost or duplicated items.", name);
+		process::Exit(process::ExitStatus::Fail);
+	}
+}
+
+// Arguments: the number of producer threads and of consumer threads, which default to half of the processors each, and the total number
+// of items.
+void QueueThroughputBenchmark(s64 argc, char **argv)
+{
+	auto half = (CPUProcessorCount() > 1) ? CPUProcessorCount() / 2 : 1;
+	auto producerCount = BenchmarkArgument(argc, argv, 0, half);
+	auto consumerCount = BenchmarkArgument(argc, argv, 1, half);
+	auto itemCount = BenchmarkArgument(argc, argv, 2, DefaultQueueThroughputItemCount);
+	log::Info("Benchmark", "%d producers and %d consumers.", producerCount, consumerCount);
+	RunQueueThroughputCase("MPMC queue, single items", MPMCQueueBenchmark, producerCount, consumerCount, itemCount, 1);
+	RunQueueThroughputCase("MPMC queue, batches", MPMCQueueBenchmark, producerCount, consumerCount, itemCount, QueueBenchmarkBatchSize);
+	if (producerCount == 1 && consumerCount == 1)
+	{
+		RunQueueThroughputCase("SPSC queue, single items", SPSCQueueBenchmark, 1, 1, itemCount, 1);
+		RunQueueThroughputCase("SPSC queue, batches", SPSCQueueBenchmark, 1, 1, itemCount, QueueBenchmarkBatchSize);
+	}
+	RunQueueThroughputCase("Locked queue, single items", LockedQueueBenchmark, producerCount, consumerCount, itemCount, 1);
+	RunQueueThroughputCase("Locked queue, batches", LockedQueueBenchmark, producerCount, consumerCount, itemCount, QueueBenchmarkBatchSize);
+}
+
+struct QueueLatency
+{
+	BenchmarkQueue requests;
+	BenchmarkQueue replies;
+	s64 roundTripCount;
+};
+
+// Thread 0 sends each item and waits for it to come back, thread 1 sends back whatever it gets.
+void RunQueueLatency(void *param, s64 threadIndex)
+{
+	auto l = (QueueLatency *)param;
+	auto from = (threadIndex == 0) ? &l->replies : &l->requests;
+	auto to = (threadIndex == 0) ? &l->requests : &l->replies;
+	for (auto i = u64{1}; i <= (u64)l->roundTripCount; i += 1)
+	{
+		auto e = i;
+		if (threadIndex == 0)
+		{
+			while (!BenchmarkQueuePush(to, arr::NewView(&e, 1)))
+			{
+				CPUSpinWaitHint();
+			}
+		}
+		while (!BenchmarkQueuePop(from, arr::NewView(&e, 1)))
+		{
+			CPUSpinWaitHint();
+		}
+		if (e != i)
+		{
+			Abort("Benchmark", "Round trip %d got item %d back.", i, e);
+		}
+		if (threadIndex == 1)
+		{
+			while (!BenchmarkQueuePush(to, arr::NewView(&e, 1)))
+			{
+				CPUSpinWaitHint();
+			}
+		}
+	}
+}
+
+// Arguments: the number of round trips.
+void QueueLatencyBenchmark(s64 argc, char **argv)
+{
+	auto roundTripCount = BenchmarkArgument(argc, argv, 0, DefaultQueueLatencyRoundTripCount);
+	const struct
+	{
+		const char *name;
+		QueueBenchmarkKind kind;
+	} cases[] =
+	{
+		{"MPMC queue round trips", MPMCQueueBenchmark},
+		{"SPSC queue round trips", SPSCQueueBenchmark},
+		{"Locked queue round trips", LockedQueueBenchmark},
+	};
+	for (auto &c : cases)
+	{
+		auto l = QueueLatency
+		{
+			.requests = NewBenchmarkQueue(c.kind),
+			.replies = NewBenchmarkQueue(c.kind),
+			.roundTripCount = roundTripCount,
+		};
+		LogBenchmarkResult(c.name, roundTripCount, RunBenchmarkThreads(2, RunQueueLatency, &l));
+		FreeBenchmarkQueue(&l.requests);
+		FreeBenchmarkQueue(&l.replies);
+	}
+}
@@ -0,0 +1,143 @@
+#include "Benchmark.h"
+#include "Basic/Mem/ConcurrentSlotAllocator.h"
+#include "Basic/Mem/SlotAllocator.h"
+#include "Basic/Mem/GlobalHeap.h"
+#include "Basic/Thread.h"
+#include "Basic/Atomic.h"
+#include "Basic/CPU.h"
+#include "Basic/Log.h"
+
+// SlotAllocatorContention: threads allocate and free fixed size slots at the same time, first each from its own window of slots, then
+// swapping slots through a shared table so that most slots get freed by a different thread than the one that allocated them. Both
+// patterns run against the lock-free ConcurrentSlotAllocator and against a SlotAllocator behind a spinlock, the way the job counter pool
+// had to be shared before.
+
+const auto SlotBenchmarkSlotSize = 64;
+const auto SlotBenchmarkSlotsPerBlock = 1024;
+const auto SlotBenchmarkWindowSize = 64;
+const auto SlotBenchmarkExchangeSize = 1024;
+const auto DefaultSlotBenchmarkOperationCount = 2 * 1000 * 1000;
+
+struct LockedSlotAllocator
+{
+	Spinlock lock;
+	mem::SlotAllocator slots;
+};
+
+struct SlotBenchmark
+{
+	bool concurrent;
+	bool exchange;
+	s64 operationCount;
+	mem::ConcurrentSlotAllocator *concurrentSlots;
+	LockedSlotAllocator *lockedSlots;
+	arr::Static<void *volatile, SlotBenchmarkExchangeSize> exchangeSlots;
+};
+
+void *AllocateBenchmarkSlot(SlotBenchmark *b)
+{
+	if (b->concurrent)
+	{
+		return b->concurrentSlots->Allocate(SlotBenchmarkSlotSize);
+	}
+	b->lockedSlots->lock.Lock();
+	auto s = b->lockedSlots->slots.Allocate(SlotBenchmarkSlotSize);
+	b->lockedSlots->lock.Unlock();
+	return s;
+}
+
+void DeallocateBenchmarkSlot(SlotBenchmark *b, void *s)
+{
+	if (b->concurrent)
+	{
+		b->concurrentSlots->Deallocate(s);
+		return;
+	}
+	b->lockedSlots->lock.Lock();
+	b->lockedSlots->slots.Deallocate(s);
+	b->lockedSlots->lock.Unlock();
+}
+
+void RunSlotBenchmark(void *param, s64 threadIndex)
+{
+	auto b = (SlotBenchmark *)param;
+	auto random = BenchmarkRandomSeed(threadIndex);
+	void *window[SlotBenchmarkWindowSize];
+	for (auto &s : window)
+	{
+		s = AllocateBenchmarkSlot(b);
+	}
+	for (auto i = 0; i < b->operationCount; i += 1)
+	{
+		auto r = BenchmarkRandom(&random);
+		auto s = AllocateBenchmarkSlot(b);
+		*(s64 *)s = i;
+		if (b->exchange)
+		{
+			// Park the new slot in the shared table and free whatever another thread parked there.
+			s = AtomicFetchAndSetPointer(&b->exchangeSlots[r % SlotBenchmarkExchangeSize], s);
+			if (!s)
+			{
+				continue;
+			}
+		}
+		else
+		{
+			auto w = &window[r % SlotBenchmarkWindowSize];
+			auto t = *w;
+			*w = s;
+			s = t;
+		}
+		DeallocateBenchmarkSlot(b, s);
+	}
+	for (auto s : window)
+	{
+		DeallocateBenchmarkSlot(b, s);
+	}
+}
+
+// Arguments: the number of threads, which defaults to one per processor, and the operations per thread.
+void SlotAllocatorContentionBenchmark(s64 argc, char **argv)
+{
+	auto threadCount = BenchmarkArgument(argc, argv, 0, CPUProcessorCount());
+	auto operationCount = BenchmarkArgument(argc, argv, 1, DefaultSlotBenchmarkOperationCount);
+	log::Info("Benchmark", "Slot allocation on %d threads.", threadCount);
+	auto concurrentSlots = mem::NewConcurrentSlotAllocator(SlotBenchmarkSlotSize, mem::DefaultAlignment, 0, SlotBenchmarkSlotsPerBlock, mem::GlobalHeap(), mem::GlobalHeap());
+	auto lockedSlots = LockedSlotAllocator
+	{
+		.slots = mem::NewSlotAllocator(SlotBenchmarkSlotSize, mem::DefaultAlignment, 0, SlotBenchmarkSlotsPerBlock, mem::GlobalHeap(), mem::GlobalHeap()),
+	};
+	const struct
+	{
+		const char *name;
+		bool concurrent;
+		bool exchange;
+	} cases[] =
+	{
+		{"Concurrent slot allocator, own slots", true, false},
+		{"Locked slot allocator, own slots", false, false},
+		{"Concurrent slot allocator, swapped slots", true, true},
+		{"Locked slot allocator, swapped slots", false, true},
+	};
+	for (auto &c : cases)
+	{
+		auto b = SlotBenchmark
+		{
+			.concurrent = c.concurrent,
+			.exchange = c.exchange,
+			.operationCount = operationCount,
+			.concurrentSlots = &concurrentSlots,
+			.lockedSlots = &lockedSlots,
+		};
+		LogBenchmarkResult(c.name, threadCount * operationCount, RunBenchmarkThreads(threadCount, RunSlotBenchmark, &b));
+		for (auto s : b.exchangeSlots)
+		{
+			if (s)
+			{
+				DeallocateBenchmarkSlot(&b, s);
+			}
+		}
+	}
+	concurrentSlots.Free();
+	lockedSlots.slots.Free();
+}
@@ -1,10 +1,15 @@
 #include "Camera.h"
 #include "Math.h"
+#include "JobSync.h"
 #include "Basic/Container/Array.h"
+#include "Basic/Container/Map.h"
+#include "Basic/Hash.h"
 
-// @TODO: Locking.
-
-auto cameras = array::Array<Camera>{};
+// Cameras never move once they're created, so lookups can hand out pointers without holding camerasLock.
+const auto MaxCameraCount = 1024;
+auto camerasLock = NewJobMutex();
+auto cameras = array::NewVirtual<Camera>(MaxCameraCount);
+auto camerasByName = map::NewConcurrent<string::String, Camera *>(0, HashString);
 
 Camera *NewCamera(string::String name, V3 pos, V3 lookAt, f32 speed, f32 fov)
 {
@@ -23,8 +28,11 @@ Camera *NewCamera(string::String name, V3 pos, V3 lookAt, f32 speed, f32 fov)
 		.focalLength = 0.01f,
 		.speed = speed,
 	};
-	cameras.Append(c);
-	return cameras.Last();
+	camerasLock.Lock();
+	Defer(camerasLock.Unlock());
+	auto p = cameras.Append(c);
+	camerasByName.Insert(name, p);
+	return p;
 }
 
 array::View<Camera> Cameras()
@@ -34,12 +42,7 @@ array::View<Camera> Cameras()
 
 Camera *LookupCamera(string::String name)
 {
-	for (auto i = 0; i < cameras.count; i += 1)
-	{
-		if (name == cameras[i].name)
-		{
-			return &cameras[i];
-		}
-	}
-	return NULL;
+	auto c = (Camera *)NULL;
+	camerasByName.Lookup(name, &c);
+	return c;
 }
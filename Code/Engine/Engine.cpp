@@ -2,10 +2,14 @@
 #include "Render.h"
 #include "Entity.h"
 #include "Job.h"
+#include "JobTrace.h"
+#include "FrameAllocator.h"
 #include "Camera.h"
 #include "Media/Input.h"
 #include "Basic/Process.h"
 #include "Basic/Log.h"
+#include "Basic/Memory/GlobalHeap.h"
+#include "Basic/Memory/AllocationTracker.h"
 #include "Basic/Time/Timer.h"
 
 s64 windowWidth, windowHeight;
@@ -22,6 +26,9 @@ s64 WindowHeight()
 
 auto cam = (Camera *){};
 
+// How often development builds log the allocation statistics, in frames.
+const auto AllocationStatisticsLogPeriod = 1000;
+
 void InitializeGameLoop()
 {
 	cam = NewCamera("Main", {2, 2, 2}, {0, 0, 0}, 0.2f, DegreesToRadians(90.0f));
@@ -81,8 +88,9 @@ void RunGame(void *)
 	InitializeAssets(NULL);
 	InitializeEntities(); // @TODO
 	InitializeGameLoop();
+	InitializeFrameAllocator();
 	auto t = Time::NewTimer("Frame");
-	while (true)
+	for (auto frame = 1;; frame += 1)
 	{
 		t.Print(Time::Millisecond);
 		t.Reset();
@@ -93,7 +101,15 @@ void RunGame(void *)
 		}
 		Update();
 		Render();
+		FinishJobTraceFrame();
+		FinishFrameAllocatorFrame();
+		Memory::UpdateGlobalHeapTrim();
+		if (frame % AllocationStatisticsLogPeriod == 0)
+		{
+			Memory::LogAllocationStatistics();
+		}
 	}
+	Memory::LogAllocationLeaks();
 	ExitProcess(ProcessSuccess);
 }
 
@@ -118,6 +134,13 @@ void LogBuildOptions()
 	#ifdef ThreadSanitizerBuild
 		LogInfo("Engine", "Static Analysis: ThreadSanitizer");
 	#endif
+	#ifdef UContextFiberBuild
+		LogInfo("Engine", "Fiber Backend: ucontext");
+	#else
+		LogInfo("Engine", "Fiber Backend: Assembly");
+	#endif
+	auto pages = Memory::GlobalHeapPageStrategies();
+	LogInfo("Engine", "Global Heap Blocks: %d small pages, %d huge pages, %d transparent huge pages", pages[Memory::PlatformSmallPages], pages[Memory::PlatformExplicitHugePages], pages[Memory::PlatformTransparentHugePages]);
 }
 
 //s32 ApplicationEntry(s32 argc, char *argv[])
@@ -129,6 +152,11 @@ s32 main(s32 argc, char *argv[])
 		{
 			SetLogLevel(VerboseLog);
 		}
+		else if (string::Equal(argv[1], "-trace"))
+		{
+			// Capture the first couple of seconds of frames.
+			TraceJobFrames("Build/JobTrace.json", 120);
+		}
 	}
 	LogBuildOptions();
 	InitializeInput();
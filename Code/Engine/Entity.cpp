@@ -1,20 +1,80 @@
 #include "Entity.h"
+#include "Basic/Pool.h"
+#include "Basic/Thread.h"
+#include "Basic/Log.h"
+#include "Basic/Memory/GlobalHeap.h"
+
+struct Entity
+{
+	Transform transform;
+	AssetID model;
+};
+
+// Entity IDs are slot map handles, so looking an entity up is an array index plus a generation check, and IDs of deleted entities are
+// caught instead of landing on whatever entity reused the slot.
+auto entitiesLock = Spinlock{};
+auto entities = pool::slotMap<Entity>{};
+
+u64 EntityHandleToID(pool::handle h)
+{
+	return ((u64)h.generation << 32) | h.index;
+}
+
+pool::handle EntityIDToHandle(u64 id)
+{
+	return
+	{
+		.index = (u32)id,
+		.generation = (u32)(id >> 32),
+	};
+}
 
 void SetEntityTransform(u64 id, Transform t)
 {
+	entitiesLock.Lock();
+	Defer(entitiesLock.Unlock());
+	auto e = entities.Lookup(EntityIDToHandle(id));
+	if (!e)
+	{
+		LogError("Entity", "Tried to set the transform of deleted entity %lu.", id);
+		return;
+	}
+	e->transform = t;
 }
 
 void SetEntityModel(u64 id, AssetID asset)
 {
+	entitiesLock.Lock();
+	Defer(entitiesLock.Unlock());
+	auto e = entities.Lookup(EntityIDToHandle(id));
+	if (!e)
+	{
+		LogError("Entity", "Tried to set the model of deleted entity %lu.", id);
+		return;
+	}
+	e->model = asset;
 }
 
 void InitializeEntities()
 {
+	entities = pool::NewSlotMapIn<Entity>(Memory::GlobalHeap(), 0);
 }
 
 u64 NewEntity()
 {
-	return 0;
+	entitiesLock.Lock();
+	Defer(entitiesLock.Unlock());
+	return EntityHandleToID(entities.Insert({}));
+}
+
+void DeleteEntity(u64 id)
+{
+	entitiesLock.Lock();
+	Defer(entitiesLock.Unlock());
+	if (!entities.Remove(EntityIDToHandle(id)))
+	{
+		LogError("Entity", "Tried to delete already deleted entity %lu.", id);
+	}
 }
 
 #if 0
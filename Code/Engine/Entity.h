@@ -7,5 +7,6 @@
 
 void InitializeEntities();
 u64 NewEntity();
+void DeleteEntity(u64 id);
 void SetEntityTransform(u64 id, Transform t);
 void SetEntityModel(u64 id, AssetID asset);
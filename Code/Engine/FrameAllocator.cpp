@@ -0,0 +1,161 @@
+#include "FrameAllocator.h"
+#include "Job.h"
+#include "Math.h"
+#include "Basic/Memory/GlobalHeap.h"
+#include "Basic/Memory/AllocationHeader.h"
+#include "Basic/Thread.h"
+
+auto frameAllocator = (struct FrameAllocator){};
+
+void InitializeFrameAllocator()
+{
+	for (auto &f : frameAllocator.arenas)
+	{
+		f = array::NewIn<FrameArena>(Memory::GlobalHeap(), WorkerThreadCount());
+		for (auto &a : f)
+		{
+			a.pool = Memory::NewPoolAllocator(FrameArenaBlockSize, 1, Memory::GlobalHeap(), Memory::GlobalHeap());
+			a.largeAllocations = array::NewIn<void *>(Memory::GlobalHeap(), 0);
+		}
+	}
+}
+
+struct FrameAllocator *FrameAllocator()
+{
+	return &frameAllocator;
+}
+
+// A job can move to another worker while it is suspended, but it can't be suspended in the middle of an allocation, so it is always safe to
+// use the arena of the thread we are on.
+FrameArena *FrameAllocator::Arena()
+{
+	auto i = ThreadIndex();
+	Assert(i >= 0 && i < this->arenas[this->frameIndex].count);
+	return &this->arenas[this->frameIndex][i];
+}
+
+void *FrameAllocator::Allocate(s64 size)
+{
+	return this->AllocateAligned(size, Memory::DefaultAlignment);
+}
+
+void *FrameAllocator::AllocateAligned(s64 size, s64 align)
+{
+	auto a = this->Arena();
+	a->allocatedBytes += size;
+	if (size + align > FrameArenaMaxSize)
+	{
+		auto mem = Memory::GlobalHeap()->AllocateAligned(size, align);
+		a->largeAllocations.Append(mem);
+		return mem;
+	}
+	return a->pool.AllocateAligned(size, align);
+}
+
+void *FrameAllocator::Resize(void *mem, s64 newSize)
+{
+	if (this->ResizeInPlace(mem, newSize))
+	{
+		return mem;
+	}
+	auto h = Memory::GetAllocationHeader(mem);
+	auto n = Minimum(h->size, newSize);
+	auto newMem = this->AllocateAligned(newSize, h->alignment);
+	CopyMemory(mem, newMem, n);
+	return newMem;
+}
+
+bool FrameAllocator::ResizeInPlace(void *mem, s64 newSize)
+{
+	auto a = this->Arena();
+	auto h = Memory::GetAllocationHeader(mem);
+	auto oldSize = h->size;
+	if (!a->pool.ResizeInPlace(mem, newSize))
+	{
+		return false;
+	}
+	if (newSize > oldSize)
+	{
+		a->allocatedBytes += newSize - oldSize;
+	}
+	return true;
+}
+
+void FrameAllocator::Deallocate(void *mem)
+{
+	// Everything is freed when the frame's arenas are reset.
+}
+
+void ResetFrameArenas(array::Array<FrameArena> f)
+{
+	for (auto &a : f)
+	{
+		a.pool.Clear();
+		for (auto m : a.largeAllocations)
+		{
+			Memory::GlobalHeap()->Deallocate(m);
+		}
+		a.largeAllocations.Resize(0);
+		a.allocatedBytes = 0;
+	}
+}
+
+void FrameAllocator::Clear()
+{
+	for (auto f : this->arenas)
+	{
+		ResetFrameArenas(f);
+	}
+}
+
+void FrameAllocator::Free()
+{
+	this->Clear();
+	for (auto &f : this->arenas)
+	{
+		for (auto &a : f)
+		{
+			a.pool.Free();
+			a.largeAllocations.Free();
+		}
+		f.Free();
+	}
+}
+
+// Must be called once the frame's jobs are done, with no other job using the frame allocator.
+void FinishFrameAllocatorFrame()
+{
+	auto a = &frameAllocator;
+	auto bytes = s64{};
+	auto largeCount = s64{};
+	for (auto &w : a->arenas[a->frameIndex])
+	{
+		bytes += w.allocatedBytes;
+		largeCount += w.largeAllocations.count;
+	}
+	a->lastFrameBytes = bytes;
+	a->peakFrameBytes = Maximum(a->peakFrameBytes, bytes);
+	a->lastFrameLargeAllocationCount = largeCount;
+	a->frameIndex = (a->frameIndex + 1) % FrameAllocatorFrameCount;
+	ResetFrameArenas(a->arenas[a->frameIndex]);
+}
+
+FrameAllocatorStatistics FrameMemoryStatistics()
+{
+	auto a = &frameAllocator;
+	auto reserved = s64{};
+	for (auto f : a->arenas)
+	{
+		for (auto &w : f)
+		{
+			reserved += (w.pool.blocks.used.count + w.pool.blocks.unused.count) * FrameArenaBlockSize;
+		}
+	}
+	return
+	{
+		.frameBytes = a->lastFrameBytes,
+		.peakFrameBytes = a->peakFrameBytes,
+		.largeAllocationCount = a->lastFrameLargeAllocationCount,
+		.reservedBytes = reserved,
+	};
+}
@@ -1,28 +1,57 @@
 #pragma once
 
-#if 0
+#include "Basic/Memory/Allocator.h"
+#include "Basic/Memory/PoolAllocator.h"
+#include "Basic/Container/Array.h"
 
-enum FrameAllocatorTag
+// Memory that only has to live until the GPU is done with the frame that allocated it. Every worker thread bumps through its own arena, so
+// allocating never takes a lock, and nothing is ever freed one by one. An arena is reset wholesale the next time its frame comes around,
+// by which point the GPU has retired the frame that last used it.
+//
+// Push FrameAllocator() as the context allocator for code that builds temporary arrays, strings and job parameters. Anything that outlives
+// the frame has to come from somewhere else.
+
+// One more than the GPU's frames in flight. When a frame finishes, the frame two before it has retired, but anything allocated since the
+// current frame started still needs its arena.
+const auto FrameAllocatorFrameCount = 3;
+const auto FrameArenaBlockSize = 1 * Megabyte;
+// Bigger allocations would waste too much of an arena block, so they come from the global heap and are freed when the arena is reset.
+const auto FrameArenaMaxSize = FrameArenaBlockSize / 4;
+
+struct FrameArena
 {
+	Memory::PoolAllocator pool;
+	array::Array<void *> largeAllocations;
+	s64 allocatedBytes;
 };
 
-struct FrameAllocatorBlock
+struct FrameAllocator : Memory::Allocator
 {
+	s64 frameIndex;
+	array::Static<array::Array<FrameArena>, FrameAllocatorFrameCount> arenas; // Indexed by frame, then by worker thread.
+	s64 lastFrameBytes;
+	s64 peakFrameBytes;
+	s64 lastFrameLargeAllocationCount;
+
+	FrameArena *Arena();
+	void *Allocate(s64 size);
+	void *AllocateAligned(s64 size, s64 align);
+	void *Resize(void *mem, s64 newSize);
+	bool ResizeInPlace(void *mem, s64 newSize);
+	void Deallocate(void *mem);
+	void Clear();
+	void Free();
 };
 
-struct FrameAllocator
+struct FrameAllocatorStatistics
 {
+	s64 frameBytes; // Allocated during the last finished frame.
+	s64 peakFrameBytes; // The most allocated during any one frame.
+	s64 largeAllocationCount; // Allocations during the last finished frame that were too big for an arena block.
+	s64 reservedBytes; // Arena blocks held by all of the arenas, in use or not.
 };
 
-AllocatorInterface FrameAllocator(FrameAllocatorTag t);
-
-HeapAllocator NewHeapAllocator(s64 blockSize, s64 blockCount, AllocatorInterface blockAlloc, AllocatorInterface arrayAlloc);
-AllocatorInterface NewHeapAllocatorInterface(HeapAllocator *heap);
-void *AllocateHeapMemory(void *heap, s64 size);
-void *AllocateAlignedHeapMemory(void *heap, s64 size, s64 alignment);
-void *ResizeHeapMemory(void *heap, void *memory, s64 size);
-void FreeHeapMemory(void *heap, void *memory);
-void ClearHeapAllocator(void *heap);
-void FreeHeapAllocator(void *heap);
-
-#endif
+void InitializeFrameAllocator();
+struct FrameAllocator *FrameAllocator();
+void FinishFrameAllocatorFrame();
+FrameAllocatorStatistics FrameMemoryStatistics();
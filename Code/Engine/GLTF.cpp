@@ -161,9 +161,9 @@ GLTFAccessor ParseGLTFAccessor(parser::Parser *p)
 	return a;
 }
 
-array::Array<GLTFAttribute> ParseGLTFAttributes(parser::Parser *p)
+array::Small<GLTFAttribute, GLTFInlineAttributeCount> ParseGLTFAttributes(parser::Parser *p)
 {
-	auto as = array::Array<GLTFAttribute>{};
+	auto as = array::Small<GLTFAttribute, GLTFInlineAttributeCount>{};
 	JSONParseObject(p, [&as](parser::Parser *p, string::String name)
 	{
 		if (name == "NORMAL")
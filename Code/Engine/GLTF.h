@@ -30,9 +30,11 @@ enum GLTFPrimitiveMode
 	GLTFTriangleFanMode = 6,
 };
 
+const auto GLTFInlineAttributeCount = 4;
+
 struct GLTFPrimitive
 {
-	array::Array<GLTFAttribute> attributes;
+	array::Small<GLTFAttribute, GLTFInlineAttributeCount> attributes;
 	s64 indices;
 	GLTFPrimitiveMode mode;
 	s64 material;
@@ -1,16 +1,37 @@
-// Special I/O thread for blocking functions.
-// Thread local storage? Fiber local storage? Fiber-safe thread local storage?
-// Adaptive mutexes?
-// Per-thread memory heap. 2mb?
-
 #include "Job.h"
+#include "JobQueue.h"
+#include "JobTrace.h"
+#include "JobIO.h"
+#include "Math.h"
 #include "Basic/Thread.h"
 #include "Basic/Atomic.h"
 #include "Basic/Container/Array.h"
 #include "Basic/Container/Dequeue.h"
+#include "Basic/Container/Queue.h"
 #include "Basic/CPU.h"
-#include "Basic/Pool.h"
 #include "Basic/Memory/GlobalHeap.h"
+#include "Basic/Memory/ConcurrentSlotAllocator.h"
+#include "Basic/Time/Time.h"
+
+// Each worker owns one work-stealing deque per priority. RunJobs pushes onto the calling worker's deque, the worker pops from the bottom
+// of its own deque, and idle workers steal from the top of a randomly chosen victim's deque. Jobs pushed from a thread that is not a
+// worker, or pushed while the local deque is full, go to the shared injection queues instead.
+const auto WorkerJobQueueSize = 4096;
+// The injection queues are lock-free rings. If one fills up, jobs spill over into a locked dequeue.
+const auto InjectedJobQueueSize = 4096;
+// A worker checks the overflow dequeue before the ring on every this many pops, so spilled jobs still run while the ring stays busy.
+const auto OverflowJobPopInterval = 64;
+// The number of finished job fibers of each stack size a worker keeps for itself before giving them back to the shared pool.
+const auto WorkerIdleFiberCacheSize = 8;
+// Stack sizes of the job fiber size classes, in pages.
+const auto NormalJobStackPageCount = 128;
+const auto SmallJobStackPageCount = 16;
+// Address space reserved for the job fibers of each stack size. Only the pages the pool grows into are committed.
+const auto MaxJobFiberCount = 64 * 1024;
+// Bounds for how many times an idle worker polls for work before parking. The limit adapts per worker: it grows when spinning finds work
+// and shrinks when it doesn't.
+const auto MinIdleSpinCount = 16;
+const auto MaxIdleSpinCount = 1024;
 
 struct WorkerThreadParameter
 {
@@ -21,205 +42,498 @@ struct WorkerThread
 {
 	Thread platformThread;
 	WorkerThreadParameter parameter;
+	array::Static<WorkStealingQueue<QueuedJob, WorkerJobQueueSize>, JobPriorityCount> jobQueues;
+	array::Static<array::Array<JobFiber *>, JobStackSizeCount> idleFibers;
+	u64 randomState;
+	s64 injectedPopCount;
+	s64 idleSpinLimit;
+	volatile s32 parked; // Futex word. Set by the worker before it parks, cleared by whoever wakes it.
+	Time::Time wakeRequestTime;
+	JobStatistics statistics;
+};
+
+// Job fibers are created the first time a size class runs dry and are recycled instead of freed, so the pool grows to whatever the
+// workload needs rather than capping the number of jobs that can be in flight. The fibers live in a virtual array, so growing the pool
+// never moves them.
+struct JobFiberSizeClass
+{
+	array::Array<JobFiber *> idleFibers; // Guarded by jobFiberPoolLock.
+	array::Virtual<JobFiber> allFibers; // Guarded by jobFiberPoolLock.
+	volatile s64 usedCount;
+	volatile s64 peakUsedCount;
 };
 
 void *WorkerThreadProcedure(void *);
 void JobFiberProcedure(void *);
 
-// @TODO: More granular locking?
-auto jobLock = Spinlock{};
+// Marks a job counter's wait list as closed: all of its jobs finished, so new waiters can resume right away.
+const auto ClosedJobCounterWaitList = (JobFiber *)1;
+
+auto jobFiberPoolLock = Spinlock{};
+auto injectedJobLock = Spinlock{};
+volatile s32 parkedWorkerCount = 0;
 auto workerThreads = array::Array<WorkerThread>{};
-auto idleJobFiberPool = []() -> pool::Static<JobFiber, JobFiberCount>
+auto workerThreadCountOverride = s64{0}; // Zero means one worker per processor.
+ThreadLocal auto workerThreadIndex = s64{-1}; // Set once by each worker thread. -1 on threads that aren't workers.
+auto jobFiberSizeClasses = []() -> array::Static<JobFiberSizeClass, JobStackSizeCount>
 {
-	auto p = pool::NewStatic<JobFiber, JobFiberCount>();
-	for (auto &f : p)
+	auto a = array::Static<JobFiberSizeClass, JobStackSizeCount>{};
+	for (auto &c : a)
 	{
-		f.platformFiber = NewFiber(JobFiberProcedure, &f.parameter);
+		c.idleFibers = array::NewIn<JobFiber *>(Memory::GlobalHeap(), 0);
+		c.allFibers = array::NewVirtual<JobFiber>(MaxJobFiberCount);
 	}
-	return p;
+	return a;
 }();
-auto jobQueues = []() -> array::Static<dequeue::Dequeue<QueuedJob>, JobPriorityCount>
+auto injectedJobQueues = []() -> array::Static<queue::MPMC<QueuedJob>, JobPriorityCount>
 {
-	auto a = array::Static<dequeue::Dequeue<QueuedJob>, JobPriorityCount>{};
-	for (auto &s : a)
+	auto a = array::Static<queue::MPMC<QueuedJob>, JobPriorityCount>{};
+	for (auto &q : a)
 	{
-		s = dequeue::NewWithBlockSizeIn<QueuedJob>(Memory::GlobalHeap(), 1024, 1024);
+		q = queue::NewMPMCIn<QueuedJob>(Memory::GlobalHeap(), InjectedJobQueueSize);
 	}
 	return a;
 }();
-auto resumableJobFiberQueues = []() -> array::Static<array::Array<JobFiber *>, JobPriorityCount>
+auto overflowJobQueues = []() -> array::Static<dequeue::Dequeue<QueuedJob>, JobPriorityCount>
 {
-	auto a = array::Static<array::Array<JobFiber *>, JobPriorityCount>{};
-	for (auto &q : a)
+	auto a = array::Static<dequeue::Dequeue<QueuedJob>, JobPriorityCount>{};
+	for (auto &s : a)
 	{
-		q = array::NewWithCapacityIn<JobFiber *>(Memory::GlobalHeap(), 100);
+		s = dequeue::NewWithBlockSizeIn<QueuedJob>(Memory::GlobalHeap(), 1024, 0);
 	}
 	return a;
 }();
-auto jobCounterPool = pool::NewIn<JobCounter>(Memory::GlobalHeap(), 0);
+auto jobCounterAllocator = Memory::NewConcurrentSlotAllocator(sizeof(JobCounter), alignof(JobCounter), 0, 1024, Memory::GlobalHeap(), Memory::GlobalHeap());
 auto runningJobFibers = array::New<JobFiber *>(WorkerThreadCount());
-//ThreadLocal auto runningJobFiber = (JobFiber *){};
-//ThreadLocal auto workerThreadFiber = Fiber{};
-auto wtf = array::New<bool>(WorkerThreadCount());
 auto workerThreadFibers = array::New<Fiber>(WorkerThreadCount());
-ThreadLocal auto waitingJobCounter = (JobCounter *){};
-
-#include "string.h"
-#include <stdio.h>
 
 void JobFiberProcedure(void *param)
 {
 	auto p = (JobFiberParameter *)param;
 	while (true)
 	{
+		TraceJobEvent(JobStartTraceEvent, p->procedure, NULL);
 		p->procedure(p->parameter);
+		TraceJobEvent(JobEndTraceEvent, p->procedure, NULL);
 		p->finished = true;
-		auto ii = p->threadIndex;
-		//printf("Switch to worker: %ld\n", ii + 1);
-		//printf("ThreadID: %ld, JobFiberProcedure, finished job %p, switching back to worker thread %ld\n", ThreadID(), p->procedure, ii);
-		workerThreadFibers[ThreadIndex()].Switch();
+		workerThreadFibers[WorkerThreadIndex()].Switch();
 	}
 }
 
-void RunGame(void *);
-void Test2(void *);
+// The index of the worker thread we are running on, which indexes every per-worker array. It isn't the same as ThreadIndex() when threads
+// were created before the workers, and it is -1 on threads that aren't workers. Job fibers move between workers, so this is kept out of
+// line to make callers look it up again after every switch.
+__attribute__((noinline)) s64 WorkerThreadIndex()
+{
+	return workerThreadIndex;
+}
 
-void *WorkerThreadProcedure(void *param)
+WorkerThread *CurrentWorkerThread()
+{
+	// Threads that are not workers (or any thread before InitializeJobs) have no deque of their own.
+	auto i = WorkerThreadIndex();
+	if (i < 0)
+	{
+		return NULL;
+	}
+	return &workerThreads[i];
+}
+
+u64 NextRandom(u64 *state)
+{
+	// xorshift64.
+	auto x = *state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return x;
+}
+
+void PushJob(WorkerThread *w, JobPriority p, QueuedJob j)
+{
+	if (w && w->jobQueues[p].Push(j))
+	{
+		return;
+	}
+	if (injectedJobQueues[p].Push(j))
+	{
+		return;
+	}
+	injectedJobLock.Lock();
+	Defer(injectedJobLock.Unlock());
+	overflowJobQueues[p].PushFront(j);
+}
+
+bool PopOverflowJob(JobPriority p, QueuedJob *j)
+{
+	if (overflowJobQueues[p].count == 0)
+	{
+		// Racy check so that idle workers don't hammer the lock.
+		return false;
+	}
+	injectedJobLock.Lock();
+	Defer(injectedJobLock.Unlock());
+	if (overflowJobQueues[p].count == 0)
+	{
+		return false;
+	}
+	*j = overflowJobQueues[p].PopBack();
+	return true;
+}
+
+bool PopInjectedJob(WorkerThread *w, JobPriority p, QueuedJob *j)
+{
+	w->injectedPopCount += 1;
+	if (w->injectedPopCount % OverflowJobPopInterval == 0 && PopOverflowJob(p, j))
+	{
+		return true;
+	}
+	return injectedJobQueues[p].Pop(j) || PopOverflowJob(p, j);
+}
+
+bool StealJob(WorkerThread *thief, JobPriority p, QueuedJob *j)
+{
+	auto n = workerThreads.count;
+	auto start = NextRandom(&thief->randomState) % n;
+	for (auto i = 0; i < n; i += 1)
+	{
+		auto victim = &workerThreads[(start + i) % n];
+		if (victim == thief)
+		{
+			continue;
+		}
+		if (victim->jobQueues[p].Steal(j))
+		{
+			TraceJobEvent(JobStealTraceEvent, j->procedure, (void *)victim->parameter.threadIndex);
+			return true;
+		}
+	}
+	return false;
+}
+
+s64 JobStackByteSize(JobStackSize s)
+{
+	switch (s)
+	{
+	case NormalJobStackSize:
+	{
+		return NormalJobStackPageCount * CPUPageSize();
+	} break;
+	case SmallJobStackSize:
+	{
+		return SmallJobStackPageCount * CPUPageSize();
+	} break;
+	case JobStackSizeCount:
+	default:
+	{
+		Abort("Job", "Unknown job stack size %d.", s);
+	} break;
+	}
+	return 0;
+}
+
+JobFiber *NewJobFiber(JobStackSize s)
+{
+	// Job fibers are never freed, and the fiber parameter pointer has to stay put, which the virtual array guarantees. The stack is made
+	// after the slot is taken, outside of the lock.
+	jobFiberPoolLock.Lock();
+	auto f = jobFiberSizeClasses[s].allFibers.Append(
+		JobFiber
+		{
+			.stackSize = s,
+		});
+	jobFiberPoolLock.Unlock();
+	auto fiber = NewFiberWithStackSize(JobFiberProcedure, &f->parameter, JobStackByteSize(s));
+	jobFiberPoolLock.Lock();
+	Defer(jobFiberPoolLock.Unlock());
+	f->platformFiber = fiber;
+	return f;
+}
+
+JobFiber *GetIdleJobFiber(WorkerThread *w, JobStackSize s)
+{
+	auto f = (JobFiber *){};
+	if (w->idleFibers[s].count > 0)
+	{
+		f = w->idleFibers[s].Pop();
+	}
+	else
+	{
+		jobFiberPoolLock.Lock();
+		if (jobFiberSizeClasses[s].idleFibers.count > 0)
+		{
+			f = jobFiberSizeClasses[s].idleFibers.Pop();
+		}
+		jobFiberPoolLock.Unlock();
+		if (!f)
+		{
+			// Creating the fiber maps its stack, so do it outside of the lock.
+			f = NewJobFiber(s);
+		}
+	}
+	auto c = &jobFiberSizeClasses[s];
+	auto used = AtomicAdd64(&c->usedCount, 1);
+	auto peak = c->peakUsedCount;
+	while (used > peak)
+	{
+		auto old = AtomicCompareAndSwap64(&c->peakUsedCount, peak, used);
+		if (old == peak)
+		{
+			break;
+		}
+		peak = old;
+	}
+	return f;
+}
+
+void ReleaseIdleJobFiber(WorkerThread *w, JobFiber *f)
+{
+	auto s = f->stackSize;
+	AtomicAdd64(&jobFiberSizeClasses[s].usedCount, -1);
+	if (w->idleFibers[s].count < WorkerIdleFiberCacheSize)
+	{
+		w->idleFibers[s].Append(f);
+		return;
+	}
+	jobFiberPoolLock.Lock();
+	Defer(jobFiberPoolLock.Unlock());
+	jobFiberSizeClasses[s].idleFibers.Append(f);
+}
+
+// Wakes up to n parked workers. Has to be called after the work they should pick up has been pushed.
+void WakeWorkers(WorkerThread *waker, s64 n)
+{
+	// Pairs with the increment in ParkWorker: either we see the parked worker, or it sees the work we just pushed when it rechecks.
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&parkedWorkerCount, __ATOMIC_RELAXED) == 0)
+	{
+		return;
+	}
+	auto now = Time::Now();
+	auto start = waker ? waker->parameter.threadIndex + 1 : 0;
+	for (auto i = 0; i < workerThreads.count && n > 0; i += 1)
+	{
+		auto w = &workerThreads[(start + i) % workerThreads.count];
+		if (w->parked == 0)
+		{
+			continue;
+		}
+		w->wakeRequestTime = now;
+		if (AtomicCompareAndSwap32(&w->parked, 1, 0) != 1)
+		{
+			// Somebody else woke it first.
+			continue;
+		}
+		FutexWake(&w->parked, 1);
+		n -= 1;
+	}
+}
+
+void ResumeJobFiber(WorkerThread *w, JobFiber *f)
+{
+	PushJob(w, f->parameter.priority,
+	{
+		.resumeFiber = f,
+	});
+	WakeWorkers(w, 1);
+}
+
+// Called by the worker after a job fiber switched away in JobCounter::Wait. The fiber is fully suspended at this point, so it is safe for
+// whoever finishes the counter to resume it on another worker.
+void AddJobCounterWaiter(WorkerThread *w, JobCounter *c, JobFiber *f)
 {
-	//auto ii = ThreadIndex();
-	auto p = (WorkerThreadParameter *)param;
-	//printf("ThreadID: %ld, ThreadIndex: %ld\n", ThreadID(), p->threadIndex);
-	//printf("RunGame: %p, Test2: %p\n", RunGame, Test2);
-	auto ii = p->threadIndex;
-	ConvertThreadToFiber(&workerThreadFibers[ThreadIndex()]);
-	auto ff = (JobFiber *){};
-	auto fff = JobFiber{};
 	while (true)
 	{
-		auto runFiber = (JobFiber *){};
-		jobLock.Lock();
-		for (auto i = (s64)HighJobPriority; i <= LowJobPriority; i += 1)
+		auto head = c->waitingFibers;
+		if (head == ClosedJobCounterWaitList)
 		{
-			if (resumableJobFiberQueues[i].count > 0)
-			{
-				runFiber = resumableJobFiberQueues[i].Pop();
-				//printf("resuming\n");
-				//Assert(runFiber->parameter.procedure == RunGame);
-				break;
-			}
-			else if (jobQueues[i].count > 0)
-			{
-				if (idleJobFiberPool.Available() == 0)
-				{
-					break;
-				}
-				runFiber = idleJobFiberPool.Get();
-				auto j = jobQueues[i].PopBack();
-				runFiber->parameter = JobFiberParameter
-				{
-					.priority = (JobPriority)i,
-					.procedure = j.procedure,
-					.parameter = j.parameter,
-					.waitingCounter = j.waitingCounter,
-					.threadIndex = ii,
-				};
-				if (j.waitingCounter)
-				{
-					//Assert(j.waitingCounter->waitingFibers.count == 1);
-					//Assert(runFiber->parameter.waitingCounter->waitingFibers.count == 1);
-				}
-				//Assert(runFiber->parameter.procedure);
-				break;
-			}
+			// All of the dependency jobs already finished. This job can resume immediately.
+			ResumeJobFiber(w, f);
+			return;
 		}
-		ff = runFiber;
-		if (ff)
+		f->nextWaitingFiber = head;
+		if (AtomicCompareAndSwapPointer((void *volatile *)&c->waitingFibers, head, f) == head)
 		{
-			//printf("GET %p %ld\n", runFiber, ii + 1);
-			fff = *runFiber;
+			return;
 		}
-		jobLock.Unlock();
-		if (!runFiber)
+	}
+}
+
+void FinishJobCounterJob(WorkerThread *w, JobCounter *c)
+{
+	if (AtomicAdd64(&c->unfinishedJobCount, -1) != 0)
+	{
+		return;
+	}
+	// This was the last job. Close the wait list so that late waiters resume themselves, and resume everyone already on it.
+	auto f = (JobFiber *)AtomicFetchAndSetPointer((void *volatile *)&c->waitingFibers, ClosedJobCounterWaitList);
+	while (f)
+	{
+		Assert(f != ClosedJobCounterWaitList);
+		// Read the link before resuming, the fiber can be running on another worker as soon as it's pushed.
+		auto next = f->nextWaitingFiber;
+		ResumeJobFiber(w, f);
+		f = next;
+	}
+}
+
+JobFiber *NextJobFiber(WorkerThread *w)
+{
+	for (auto i = (s64)HighJobPriority; i <= LowJobPriority; i += 1)
+	{
+		auto p = (JobPriority)i;
+		auto j = QueuedJob{};
+		if (!w->jobQueues[p].Pop(&j) && !PopInjectedJob(w, p, &j) && !StealJob(w, p, &j))
 		{
 			continue;
 		}
-		runningJobFibers[ThreadIndex()] = runFiber;
-		//printf("ThreadID: %ld, WorkerThreadProcedure, running job fiber %p(%p)\n", ThreadID(), runFiber, runFiber->parameter.procedure);
-		runFiber->platformFiber.Switch();
-		#if 0
-		jobLock.Lock();
-		Assert(ff == runFiber);
-		memcmp(runFiber, &ff, sizeof(JobFiber));
-		//printf("RELEASE %p, %ld\n", runFiber, ii + 1);
-		if (runFiber->parameter.finished)
+		if (j.resumeFiber)
 		{
-			idleJobFiberPool.Release(runFiber);
-			//ConsolePrint("%ld\n", idleJobFiberPool.Available());
+			return j.resumeFiber;
 		}
-		jobLock.Unlock();
-		#else
-		jobLock.Lock();
-		Defer(jobLock.Unlock());
-		//Assert(runFiber->parameter.waitingCounter->waitingFibers.count == 1);
-		if (runFiber->parameter.finished)
+		auto f = GetIdleJobFiber(w, j.stackSize);
+		f->parameter = JobFiberParameter
 		{
-			//printf("ThreadID: %ld, WorkerThreadProcedure, done with fiber %p(%p), finished job, finished counter %p\n", ThreadID(), runFiber, runFiber->parameter.procedure, runFiber->parameter.waitingCounter);
-			idleJobFiberPool.Release(runFiber);
-			if (!runFiber->parameter.waitingCounter)
+			.priority = p,
+			.procedure = j.procedure,
+			.parameter = j.parameter,
+			.waitingCounter = j.waitingCounter,
+			.threadIndex = w->parameter.threadIndex,
+		};
+		return f;
+	}
+	return NULL;
+}
+
+// Returns a job fiber if work showed up while the worker was getting ready to park, otherwise sleeps until woken and returns NULL.
+JobFiber *ParkWorker(WorkerThread *w)
+{
+	w->parked = 1;
+	AtomicAdd32(&parkedWorkerCount, 1);
+	if (auto f = NextJobFiber(w); f)
+	{
+		w->parked = 0;
+		AtomicAdd32(&parkedWorkerCount, -1);
+		return f;
+	}
+	auto start = Time::Now();
+	while (__atomic_load_n(&w->parked, __ATOMIC_ACQUIRE) == 1)
+	{
+		FutexWait(&w->parked, 1);
+	}
+	AtomicAdd32(&parkedWorkerCount, -1);
+	auto end = Time::Now();
+	auto latency = (end - w->wakeRequestTime).Nanoseconds();
+	w->statistics.parkCount += 1;
+	w->statistics.parkedNanoseconds += (end - start).Nanoseconds();
+	w->statistics.wakeLatencyNanoseconds += latency;
+	w->statistics.maxWakeLatencyNanoseconds = Maximum(w->statistics.maxWakeLatencyNanoseconds, latency);
+	return NULL;
+}
+
+JobFiber *WaitForJobFiber(WorkerThread *w)
+{
+	while (true)
+	{
+		for (auto i = 0; i < w->idleSpinLimit; i += 1)
+		{
+			CPUSpinWaitHint();
+			if (auto f = NextJobFiber(w); f)
 			{
-				continue;
+				// Spinning paid off, so spin a bit longer next time.
+				w->idleSpinLimit = Minimum(w->idleSpinLimit * 2, MaxIdleSpinCount);
+				w->statistics.spinWakeCount += 1;
+				return f;
 			}
-			runFiber->parameter.waitingCounter->unfinishedJobCount -= 1;
-			//Assert(runFiber->parameter.waitingCounter->unfinishedJobCount == 0);
-			//Assert(runFiber->parameter.waitingCounter->waitingFibers.count == 1);
-			if (runFiber->parameter.waitingCounter->unfinishedJobCount == 0)
+		}
+		w->idleSpinLimit = Maximum(w->idleSpinLimit / 2, MinIdleSpinCount);
+		if (auto f = ParkWorker(w); f)
+		{
+			return f;
+		}
+	}
+}
+
+void *WorkerThreadProcedure(void *param)
+{
+	auto p = (WorkerThreadParameter *)param;
+	workerThreadIndex = p->threadIndex;
+	auto w = &workerThreads[p->threadIndex];
+	ConvertThreadToFiber(&workerThreadFibers[p->threadIndex]);
+	while (true)
+	{
+		auto runFiber = NextJobFiber(w);
+		if (!runFiber)
+		{
+			runFiber = WaitForJobFiber(w);
+		}
+		runningJobFibers[p->threadIndex] = runFiber;
+		TraceJobEvent(JobFiberSwitchTraceEvent, runFiber->parameter.procedure, runFiber);
+		runFiber->platformFiber.Switch();
+		runningJobFibers[p->threadIndex] = NULL;
+		if (runFiber->parameter.finished)
+		{
+			// Grab the counter before releasing the fiber, another worker might reuse it right away.
+			auto c = runFiber->parameter.waitingCounter;
+			ReleaseIdleJobFiber(w, runFiber);
+			if (c)
 			{
-				for (auto &f : runFiber->parameter.waitingCounter->waitingFibers)
-				{
-					resumableJobFiberQueues[f->parameter.priority].Append(f);
-				}
+				FinishJobCounterJob(w, c);
 			}
-		//	printf("rq: %ld\n", resumableJobFiberQueues[0].count);
+		}
+		else if (auto c = runFiber->parameter.blockingCounter; c)
+		{
+			runFiber->parameter.blockingCounter = NULL;
+			TraceJobEvent(JobCounterWaitTraceEvent, runFiber->parameter.procedure, c);
+			AddJobCounterWaiter(w, c, runFiber);
 		}
 		else
 		{
-			//printf("ThreadID: %ld, WorkerThreadProcedure, done with fiber, retiring fiber %p(%p)\n", ThreadID(), runFiber, runFiber->parameter.procedure);
-			// @TODO: Job counter locking.
-			if (waitingJobCounter->unfinishedJobCount == 0)
-			{
-				// All of the dependency jobs already finished. This job can resume immediately.
-				resumableJobFiberQueues[runFiber->parameter.priority].Append(runFiber);
-			}
-			else
-			{
-				// The dependency jobs are still running. Add this fiber to the wait list.
-				waitingJobCounter->waitingFibers.Append(runFiber);
-			}
+			auto s = runFiber->parameter.suspendProcedure;
+			Assert(s);
+			runFiber->parameter.suspendProcedure = NULL;
+			TraceJobEvent(JobCounterWaitTraceEvent, runFiber->parameter.procedure, runFiber->parameter.suspendParameter);
+			s(runFiber, runFiber->parameter.suspendParameter);
 		}
-		#endif
 	}
 }
 
 void InitializeJobs(JobProcedure initProc, void *initParam)
 {
 	workerThreads = array::NewIn<WorkerThread>(Memory::GlobalHeap(), WorkerThreadCount());
+	for (auto i = 0; i < workerThreads.count; i += 1)
+	{
+		auto w = &workerThreads[i];
+		w->parameter.threadIndex = i;
+		for (auto &q : w->jobQueues)
+		{
+			q.top = 0;
+			q.bottom = 0;
+		}
+		for (auto &c : w->idleFibers)
+		{
+			c = array::NewWithCapacityIn<JobFiber *>(Memory::GlobalHeap(), WorkerIdleFiberCacheSize);
+		}
+		// xorshift needs a non-zero seed.
+		w->randomState = 0x9E3779B97F4A7C15ull * (i + 1);
+		w->idleSpinLimit = MinIdleSpinCount;
+		w->parked = 0;
+		w->statistics = {};
+	}
 	workerThreads[0].platformThread = CurrentThread();
-	//workerThreads.Last()->platformThread = CurrentThread();
 	for (auto i = 1; i < workerThreads.count; i += 1)
-	//for (auto i = 0; i < workerThreads.count - 1; i += 1)
 	{
-		workerThreads[i].parameter.threadIndex = i;
 		workerThreads[i].platformThread = NewThread(WorkerThreadProcedure, &workerThreads[i].parameter);
 	}
 	for (auto i = 0; i < workerThreads.count; i += 1)
 	{
-		wtf[i] = true;
 		SetThreadProcessorAffinity(workerThreads[i].platformThread, i);
 	}
+	InitializeJobIO();
 	auto j = NewJobDeclaration(initProc, initParam);
 	RunJobs(array::NewView(&j, 1), HighJobPriority, NULL);
 	WorkerThreadProcedure(&workerThreads[0].parameter);
-	//WorkerThreadProcedure(&workerThreads.Last()->parameter);
 }
 
 JobDeclaration NewJobDeclaration(JobProcedure proc, void *param)
@@ -228,108 +542,184 @@ JobDeclaration NewJobDeclaration(JobProcedure proc, void *param)
 	{
 		.procedure = proc,
 		.parameter = param,
+		.stackSize = NormalJobStackSize,
+	};
+}
+
+JobDeclaration NewJobDeclarationWithStackSize(JobProcedure proc, void *param, JobStackSize s)
+{
+	return
+	{
+		.procedure = proc,
+		.parameter = param,
+		.stackSize = s,
 	};
 }
 
+JobCounter *NewJobCounter(s64 jobCount)
+{
+	auto c = (JobCounter *)jobCounterAllocator.Allocate(sizeof(JobCounter));
+	c->jobCount = jobCount;
+	c->Reset();
+	return c;
+}
+
 void RunJobs(array::View<JobDeclaration> js, JobPriority p, JobCounter **c)
 {
-	jobLock.Lock();
-	Defer(jobLock.Unlock());
 	auto counter = (JobCounter *){};
 	if (c)
 	{
-		counter = jobCounterPool.Get();
-		counter->jobCount = js.count;
-		counter->unfinishedJobCount = js.count;
-		counter->waitingFibers.SetAllocator(Memory::GlobalHeap());
-		Assert(counter->waitingFibers.capacity == 0 && counter->waitingFibers.count == 0);
+		counter = NewJobCounter(js.count);
 		*c = counter;
-	/*
-		*c = jobCounterPool.Get();
-		(*c)->jobCount = js.count;
-		(*c)->unfinishedJobCount = js.count;
-		(*c)->waitingFibers.SetAllocator(GlobalAllocator());
-		Assert((*c)->waitingFibers.capacity == 0 && (*c)->waitingFibers.count == 0);
-		counter = *c;
-	*/
 	}
+	RunJobsWithCounter(js, p, counter);
+}
+
+// Runs the jobs against a counter that was already sized for them, e.g. by NewJobCounter. Used when a counter covers jobs that are
+// pushed at different times.
+void RunJobsWithCounter(array::View<JobDeclaration> js, JobPriority p, JobCounter *counter)
+{
+	auto w = CurrentWorkerThread();
 	for (auto j : js)
 	{
 		Assert(j.procedure);
-		auto qj = QueuedJob
-		{
-			.procedure = j.procedure,
-			.parameter = j.parameter,
-			.waitingCounter = counter,
-		};
-		if (c)
-		{
-			//Assert(qj.waitingCounter->waitingFibers.count == 0);
-		}
-		jobQueues[p].PushFront(qj);
-		/*
-		jobQueues[p].PushFront(
+		PushJob(w, p,
 		{
 			.procedure = j.procedure,
 			.parameter = j.parameter,
 			.waitingCounter = counter,
+			.stackSize = j.stackSize,
 		});
-		*/
-	}
-	if (c)
-	{
-		//Assert(counter->jobCount == 1);
-		//Assert(counter->unfinishedJobCount == 1);
-		//Assert(counter->waitingFibers.count == 0);
 	}
+	WakeWorkers(w, js.count);
 }
 
 void JobCounter::Wait()
 {
-	if (this->unfinishedJobCount == 0)
+	if (__atomic_load_n(&this->waitingFibers, __ATOMIC_ACQUIRE) == ClosedJobCounterWaitList)
 	{
-		// The jobs already finished.
-		//printf("ThreadID: %ld, JobCounter::Wait(), job counter %p already finished, returning\n", ThreadID(), this);
+		// The jobs already finished. Checking the wait list rather than unfinishedJobCount makes sure the last job is done touching
+		// the counter, so the caller can free it right away.
 		return;
 	}
-	waitingJobCounter = this;
-	auto ii = ThreadIndex();
-	#if 0
-	// @TODO: Have a per-counter lock?
-	{
-		jobLock.Lock();
-		Defer(jobLock.Unlock());
-		if (this->unfinishedJobCount == 0)
-		{
-			//Assert(0);
-			printf("ThreadID: %ld, JobCounter::Wait(), job counter %p already finished, returning\n", ThreadID(), this);
-			return;
-		}
-		this->waitingFibers.Append(runningJobFibers[ii]);
-		Assert(wtf[ii] == false);
-	}
-	#endif
-	//Assert(this->waitingFibers.count == 1);
-	//printf("ThreadID: %ld, JobCounter::Wait(), waiting on job counter %p, switching to worker thread %ld\n", ThreadID(), this, ii);
-	workerThreadFibers[ThreadIndex()].Switch();
+	// The worker thread registers us as a waiter once we have switched away. Registering here would let the last job resume this
+	// fiber on another worker before it finished suspending.
+	runningJobFibers[WorkerThreadIndex()]->parameter.blockingCounter = this;
+	workerThreadFibers[WorkerThreadIndex()].Switch();
+	// We might be on a different worker now.
+	TraceJobEvent(JobCounterResumeTraceEvent, runningJobFibers[WorkerThreadIndex()]->parameter.procedure, this);
 }
 
+// Marks one of the counter's jobs as finished, for work that completes outside of the job system (e.g. on an I/O thread). Can be called
+// from any thread.
+void JobCounter::Finish()
+{
+	FinishJobCounterJob(CurrentWorkerThread(), this);
+}
+
+// Must not be called while jobs or waiters are still using the counter.
 void JobCounter::Reset()
 {
-	jobLock.Lock();
-	Defer(jobLock.Unlock());
 	this->unfinishedJobCount = this->jobCount;
-	this->waitingFibers.Resize(0);
+	this->waitingFibers = (this->jobCount > 0) ? NULL : ClosedJobCounterWaitList;
+	__atomic_thread_fence(__ATOMIC_RELEASE);
 }
 
 void JobCounter::Free()
 {
-	jobLock.Lock();
-	Defer(jobLock.Unlock());
-	jobCounterPool.Release(this);
+	jobCounterAllocator.Deallocate(this);
+}
+
+// The priority of the job running on this fiber, for work it spawns on its behalf.
+JobPriority RunningJobPriority()
+{
+	if (!RunningInJob())
+	{
+		return NormalJobPriority;
+	}
+	return runningJobFibers[WorkerThreadIndex()]->parameter.priority;
+}
+
+// Returns true if called from a job fiber, as opposed to a thread that isn't a worker or a worker's own scheduling fiber.
+bool RunningInJob()
+{
+	if (!CurrentWorkerThread())
+	{
+		return false;
+	}
+	return runningJobFibers[WorkerThreadIndex()] != NULL;
+}
+
+// Switches away from the running job. Once the job fiber has fully suspended, the worker calls proc(fiber, param) and moves on to other
+// work. proc has to make sure that ResumeSuspendedJob gets called on the fiber exactly once, either right away or later from any thread.
+void SuspendRunningJob(JobSuspendProcedure proc, void *param)
+{
+	Assert(RunningInJob());
+	auto f = runningJobFibers[WorkerThreadIndex()];
+	f->parameter.suspendProcedure = proc;
+	f->parameter.suspendParameter = param;
+	workerThreadFibers[WorkerThreadIndex()].Switch();
+	TraceJobEvent(JobCounterResumeTraceEvent, runningJobFibers[WorkerThreadIndex()]->parameter.procedure, param);
+}
+
+void ResumeSuspendedJob(JobFiber *f)
+{
+	ResumeJobFiber(CurrentWorkerThread(), f);
+}
+
+JobStatistics JobSystemStatistics()
+{
+	// The per-worker statistics are read without synchronization, so this is only a snapshot.
+	auto s = JobStatistics{};
+	for (auto &w : workerThreads)
+	{
+		s.spinWakeCount += w.statistics.spinWakeCount;
+		s.parkCount += w.statistics.parkCount;
+		s.parkedNanoseconds += w.statistics.parkedNanoseconds;
+		s.wakeLatencyNanoseconds += w.statistics.wakeLatencyNanoseconds;
+		s.maxWakeLatencyNanoseconds = Maximum(s.maxWakeLatencyNanoseconds, w.statistics.maxWakeLatencyNanoseconds);
+	}
+	for (auto i = 0; i < JobStackSizeCount; i += 1)
+	{
+		auto c = &jobFiberSizeClasses[i];
+		// Copy the fibers out under the lock and scan their stacks after letting go of it, so workers that need a fiber aren't held up.
+		// Job fibers are never freed, so the stacks stay mapped.
+		jobFiberPoolLock.Lock();
+		s.fiberCounts[i] = c->allFibers.count;
+		s.peakUsedFiberCounts[i] = c->peakUsedCount;
+		auto fibers = array::NewWithCapacityIn<Fiber>(Memory::GlobalHeap(), c->allFibers.count);
+		for (auto &f : c->allFibers)
+		{
+			// Skip fibers whose stack is still being made.
+			if (f.platformFiber.stack)
+			{
+				fibers.Append(f.platformFiber);
+			}
+		}
+		jobFiberPoolLock.Unlock();
+		// Asks the kernel which stack pages are resident, so this is too slow to call every frame.
+		for (auto &f : fibers)
+		{
+			s.stackHighWaterMarks[i] = Maximum(s.stackHighWaterMarks[i], f.StackHighWaterMark());
+		}
+		fibers.Free();
+	}
+	return s;
+}
+
+// Must be called before InitializeJobs. Used by the benchmarks to see how the job system scales with fewer workers than processors.
+void SetWorkerThreadCount(s64 n)
+{
+	Assert(workerThreads.count == 0);
+	Assert(n > 0 && n <= CPUProcessorCount());
+	workerThreadCountOverride = n;
 }
 
 s64 WorkerThreadCount()
 {
+	if (workerThreadCountOverride > 0)
+	{
+		return workerThreadCountOverride;
+	}
 	return CPUProcessorCount();
 }
@@ -1,10 +1,9 @@
 #pragma once
 
 #include "Basic/Fiber.h"
+#include "Basic/Container/Array.h"
 #include "Common.h"
 
-constexpr auto JobFiberCount = 160;
-
 enum JobPriority
 {
 	HighJobPriority,
@@ -13,15 +12,28 @@ enum JobPriority
 	JobPriorityCount
 };
 
+// The size class of the fiber stack a job runs on. Short leaf jobs that don't recurse or keep big arrays on the stack can ask for a small
+// stack so that many of them can be suspended at once without tying up address space.
+enum JobStackSize
+{
+	NormalJobStackSize,
+	SmallJobStackSize,
+	JobStackSizeCount
+};
+
 struct JobCounter;
+struct JobFiber;
 
 typedef void (*JobProcedure)(void *);
+typedef void (*JobSuspendProcedure)(JobFiber *f, void *param);
 
 struct QueuedJob
 {
 	JobProcedure procedure;
 	void *parameter;
 	JobCounter *waitingCounter;
+	JobStackSize stackSize;
+	JobFiber *resumeFiber; // If set, this is a suspended job that is ready to continue rather than a new job.
 };
 
 struct JobFiberParameter
@@ -31,22 +43,30 @@ struct JobFiberParameter
 	void *parameter;
 	bool finished;
 	JobCounter *waitingCounter; // The job counter waiting on this job to complete. Can be NULL.
+	JobCounter *blockingCounter; // The job counter this job is waiting on, set by JobCounter::Wait. Can be NULL.
+	JobSuspendProcedure suspendProcedure; // Set by SuspendRunningJob. Can be NULL.
+	void *suspendParameter;
 	s64 threadIndex;
 };
 
 struct JobFiber
 {
 	Fiber platformFiber;
+	JobStackSize stackSize;
 	JobFiberParameter parameter;
+	JobFiber *nextWaitingFiber; // Links the fibers waiting on the same job counter.
 };
 
+// Jobs finish by atomically decrementing unfinishedJobCount. Suspended fibers push themselves onto the lock-free waitingFibers list, and
+// the last job to finish closes the list and makes every fiber on it resumable.
 struct JobCounter
 {
 	s64 jobCount;
-	s64 unfinishedJobCount;
-	array::Array<JobFiber *> waitingFibers;
+	volatile s64 unfinishedJobCount;
+	JobFiber *volatile waitingFibers;
 
 	void Wait();
+	void Finish();
 	void Reset();
 	void Free();
 };
@@ -55,9 +75,33 @@ struct JobDeclaration
 {
 	JobProcedure procedure;
 	void *parameter;
+	JobStackSize stackSize;
+};
+
+struct JobStatistics
+{
+	s64 spinWakeCount; // Times an idle worker found work while spinning, before it had to park.
+	s64 parkCount; // Times a worker parked and was woken up again.
+	s64 parkedNanoseconds; // Total time workers spent parked instead of burning a core.
+	s64 wakeLatencyNanoseconds; // Total time between a wake request and the parked worker running again.
+	s64 maxWakeLatencyNanoseconds;
+	// Job fibers are created on demand, so these show how many a workload really needs.
+	array::Static<s64, JobStackSizeCount> fiberCounts; // Job fibers created so far.
+	array::Static<s64, JobStackSizeCount> peakUsedFiberCounts; // Most job fibers running or suspended at the same time.
+	array::Static<s64, JobStackSizeCount> stackHighWaterMarks; // The deepest any job fiber's stack has gone, in bytes.
 };
 
 void InitializeJobs(JobProcedure init, void *param);
 JobDeclaration NewJobDeclaration(JobProcedure proc, void *param);
+JobDeclaration NewJobDeclarationWithStackSize(JobProcedure proc, void *param, JobStackSize s);
 void RunJobs(array::View<JobDeclaration> d, JobPriority p, JobCounter **c);
+JobCounter *NewJobCounter(s64 jobCount);
+void RunJobsWithCounter(array::View<JobDeclaration> d, JobPriority p, JobCounter *c);
+JobPriority RunningJobPriority();
+bool RunningInJob();
+void SuspendRunningJob(JobSuspendProcedure proc, void *param);
+void ResumeSuspendedJob(JobFiber *f);
+void SetWorkerThreadCount(s64 n);
 s64 WorkerThreadCount();
+s64 WorkerThreadIndex();
+JobStatistics JobSystemStatistics();
@@ -0,0 +1,188 @@
+#include "JobGraph.h"
+#include "Basic/Atomic.h"
+#include "Basic/Log.h"
+
+JobGraph NewJobGraphIn(Memory::Allocator *a, s64 jobCap, s64 depCap)
+{
+	return
+	{
+		.nodes = array::NewWithCapacityIn<JobGraphNode>(a, jobCap),
+		.dependencies = array::NewWithCapacityIn<JobGraphDependency>(a, depCap),
+		.successors = array::NewWithCapacityIn<s64>(a, depCap),
+		.readyJobs = array::NewWithCapacityIn<JobDeclaration>(a, jobCap),
+	};
+}
+
+JobGraph NewJobGraph(s64 jobCap, s64 depCap)
+{
+	return NewJobGraphIn(Memory::ContextAllocator(), jobCap, depCap);
+}
+
+s64 JobGraph::AddJob(JobProcedure proc, void *param, JobPriority p)
+{
+	Assert(proc);
+	this->nodes.Append(
+	{
+		.procedure = proc,
+		.parameter = param,
+		.priority = p,
+	});
+	this->compiled = false;
+	return this->nodes.count - 1;
+}
+
+void JobGraph::AddDependency(s64 before, s64 after)
+{
+	Assert(before >= 0 && before < this->nodes.count);
+	Assert(after >= 0 && after < this->nodes.count);
+	Assert(before != after);
+	this->dependencies.Append(
+	{
+		.before = before,
+		.after = after,
+	});
+	this->compiled = false;
+}
+
+void RunJobGraphNode(void *param);
+
+// Packs the dependency list into per-node successor ranges so that finishing a node only has to walk a contiguous slice.
+void CompileJobGraph(JobGraph *g)
+{
+	for (auto &n : g->nodes)
+	{
+		n.predecessorCount = 0;
+		n.successorCount = 0;
+	}
+	for (auto d : g->dependencies)
+	{
+		g->nodes[d.before].successorCount += 1;
+		g->nodes[d.after].predecessorCount += 1;
+	}
+	auto first = 0;
+	for (auto &n : g->nodes)
+	{
+		n.firstSuccessor = first;
+		first += n.successorCount;
+		n.successorCount = 0;
+	}
+	g->successors.Resize(g->dependencies.count);
+	for (auto d : g->dependencies)
+	{
+		auto n = &g->nodes[d.before];
+		g->successors[n->firstSuccessor + n->successorCount] = d.after;
+		n->successorCount += 1;
+	}
+	#ifdef DebugBuild
+		// Make sure the graph has no cycles, otherwise it would never finish.
+		auto ready = array::NewWithCapacity<s64>(g->nodes.count);
+		auto remaining = array::New<s64>(g->nodes.count);
+		for (auto i = 0; i < g->nodes.count; i += 1)
+		{
+			remaining[i] = g->nodes[i].predecessorCount;
+			if (remaining[i] == 0)
+			{
+				ready.Append(i);
+			}
+		}
+		auto visited = 0;
+		while (ready.count > 0)
+		{
+			auto n = &g->nodes[ready.Pop()];
+			visited += 1;
+			for (auto i = n->firstSuccessor; i < n->firstSuccessor + n->successorCount; i += 1)
+			{
+				remaining[g->successors[i]] -= 1;
+				if (remaining[g->successors[i]] == 0)
+				{
+					ready.Append(g->successors[i]);
+				}
+			}
+		}
+		if (visited != g->nodes.count)
+		{
+			Abort("Job", "Job graph has a dependency cycle.");
+		}
+		ready.Free();
+		remaining.Free();
+	#endif
+	g->compiled = true;
+}
+
+void RunJobGraphNode(void *param)
+{
+	auto n = (JobGraphNode *)param;
+	n->procedure(n->parameter);
+	auto g = n->graph;
+	for (auto i = n->firstSuccessor; i < n->firstSuccessor + n->successorCount; i += 1)
+	{
+		auto s = &g->nodes[g->successors[i]];
+		if (AtomicAdd64(&s->unfinishedPredecessorCount, -1) == 0)
+		{
+			// We were the last predecessor, so the successor is ready to run. The graph's counter was sized for every node up front, so
+			// it can't reach zero before this job returns.
+			auto j = NewJobDeclaration(RunJobGraphNode, s);
+			RunJobsWithCounter(array::NewView(&j, 1), s->priority, g->counter);
+		}
+	}
+}
+
+// The returned counter finishes once every job in the graph has finished. The graph must not be changed or submitted again until then.
+JobCounter *JobGraph::Submit()
+{
+	if (!this->compiled)
+	{
+		CompileJobGraph(this);
+	}
+	if (!this->counter)
+	{
+		this->counter = NewJobCounter(this->nodes.count);
+	}
+	else
+	{
+		this->counter->jobCount = this->nodes.count;
+		this->counter->Reset();
+	}
+	for (auto &n : this->nodes)
+	{
+		n.graph = this;
+		n.unfinishedPredecessorCount = n.predecessorCount;
+	}
+	for (auto p = (s64)HighJobPriority; p <= LowJobPriority; p += 1)
+	{
+		this->readyJobs.Resize(0);
+		for (auto &n : this->nodes)
+		{
+			if (n.predecessorCount == 0 && n.priority == p)
+			{
+				this->readyJobs.Append(NewJobDeclaration(RunJobGraphNode, &n));
+			}
+		}
+		if (this->readyJobs.count > 0)
+		{
+			RunJobsWithCounter(this->readyJobs, (JobPriority)p, this->counter);
+		}
+	}
+	return this->counter;
+}
+
+void JobGraph::Clear()
+{
+	this->nodes.Resize(0);
+	this->dependencies.Resize(0);
+	this->successors.Resize(0);
+	this->compiled = false;
+}
+
+void JobGraph::Free()
+{
+	this->nodes.Free();
+	this->dependencies.Free();
+	this->successors.Free();
+	this->readyJobs.Free();
+	if (this->counter)
+	{
+		this->counter->Free();
+		this->counter = NULL;
+	}
+}
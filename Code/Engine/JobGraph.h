@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Job.h"
+#include "Basic/Container/Array.h"
+#include "Basic/Memory.h"
+
+// A set of jobs with ordering constraints between them. Instead of a job calling JobCounter::Wait to enforce an edge, each job is pushed
+// to the scheduler by whichever predecessor finishes last, so no fiber ever blocks inside the graph.
+//
+// Build the graph with AddJob and AddDependency, then Submit it and wait on the counter it returns. The counter belongs to the graph. A
+// graph can be submitted again after its counter finishes, and Clear keeps the allocated memory so the graph can be rebuilt every frame
+// without allocating.
+
+struct JobGraph;
+
+struct JobGraphNode
+{
+	JobGraph *graph;
+	JobProcedure procedure;
+	void *parameter;
+	JobPriority priority;
+	s64 predecessorCount;
+	s64 firstSuccessor; // Index into JobGraph::successors.
+	s64 successorCount;
+	volatile s64 unfinishedPredecessorCount;
+};
+
+struct JobGraphDependency
+{
+	s64 before;
+	s64 after;
+};
+
+struct JobGraph
+{
+	array::Array<JobGraphNode> nodes;
+	array::Array<JobGraphDependency> dependencies;
+	array::Array<s64> successors;
+	array::Array<JobDeclaration> readyJobs;
+	JobCounter *counter;
+	bool compiled;
+
+	s64 AddJob(JobProcedure proc, void *param, JobPriority p);
+	void AddDependency(s64 before, s64 after);
+	JobCounter *Submit();
+	void Clear();
+	void Free();
+};
+
+JobGraph NewJobGraphIn(Memory::Allocator *a, s64 jobCapacity, s64 dependencyCapacity);
+JobGraph NewJobGraph(s64 jobCapacity, s64 dependencyCapacity);
@@ -0,0 +1,148 @@
+#include "JobIO.h"
+#include "Basic/Thread.h"
+#include "Basic/Atomic.h"
+#include "Basic/File.h"
+#include "Basic/Log.h"
+#include "Basic/Container/Queue.h"
+#include "Basic/Memory/GlobalHeap.h"
+#include "Basic/Memory/ContextAllocator.h"
+
+// Disk requests mostly wait on the device, so a couple of threads are enough to keep it busy without taking cores from the workers.
+const auto IOThreadCount = 2;
+// Every queued request belongs to a suspended job, so this only fills up if thousands of jobs are waiting on the disk at once.
+const auto IORequestQueueSize = 4096;
+
+struct IORequest
+{
+	JobProcedure procedure;
+	void *parameter;
+	JobCounter *counter;
+};
+
+auto ioRequests = queue::NewMPMCIn<IORequest *>(Memory::GlobalHeap(), IORequestQueueSize);
+volatile s32 ioRequestSignal = 0; // Futex word. Bumped every time a request is pushed.
+auto ioThreads = array::Array<Thread>{};
+
+void *IOThreadProcedure(void *)
+{
+	while (true)
+	{
+		// Read the signal before checking the queue, so a request pushed in between makes FutexWait return right away.
+		auto signal = __atomic_load_n(&ioRequestSignal, __ATOMIC_ACQUIRE);
+		auto r = (IORequest *){};
+		if (!ioRequests.Pop(&r))
+		{
+			FutexWait(&ioRequestSignal, signal);
+			continue;
+		}
+		r->procedure(r->parameter);
+		// The request lives on the suspended job's stack, so it's gone as soon as the job can resume.
+		r->counter->Finish();
+	}
+	return NULL;
+}
+
+// Called by InitializeJobs after the workers are started, so the I/O threads don't take thread indices meant for workers.
+void InitializeJobIO()
+{
+	ioThreads = array::NewIn<Thread>(Memory::GlobalHeap(), IOThreadCount);
+	for (auto &t : ioThreads)
+	{
+		t = NewThread(IOThreadProcedure, NULL);
+	}
+}
+
+// Runs proc on an I/O thread and suspends the calling job until it returns. Outside of a job there is nothing to suspend (a worker's
+// scheduling fiber, the main thread before the workers start, an I/O thread), so proc just runs on the calling thread.
+void RunOnIOThread(JobProcedure proc, void *param)
+{
+	if (!RunningInJob())
+	{
+		proc(param);
+		return;
+	}
+	auto r = IORequest
+	{
+		.procedure = proc,
+		.parameter = param,
+		.counter = NewJobCounter(1),
+	};
+	Defer(r.counter->Free());
+	if (!ioRequests.Push(&r))
+	{
+		// Too much queued up already, so block this worker instead of making the job wait behind everything else.
+		proc(param);
+		return;
+	}
+	AtomicAdd32(&ioRequestSignal, 1);
+	FutexWake(&ioRequestSignal, 1);
+	r.counter->Wait();
+}
+
+struct ReadEntireFileIORequest
+{
+	string::String path;
+	Memory::Allocator *allocator; // The calling job's context allocator, which the result has to come from.
+	array::Array<u8> result;
+	bool error;
+};
+
+void ReadEntireFileIO(void *param)
+{
+	auto r = (ReadEntireFileIORequest *)param;
+	Memory::PushContextAllocator(r->allocator);
+	Defer(Memory::PopContextAllocator());
+	r->result = ReadEntireFile(r->path, &r->error);
+}
+
+array::Array<u8> ReadEntireFileOnIOThread(string::String path, bool *err)
+{
+	auto r = ReadEntireFileIORequest
+	{
+		.path = path,
+		.allocator = Memory::ContextAllocator(),
+	};
+	RunOnIOThread(ReadEntireFileIO, &r);
+	if (r.error)
+	{
+		*err = true;
+	}
+	return r.result;
+}
+
+struct WriteEntireFileIORequest
+{
+	string::String path;
+	array::View<u8> data;
+	bool error;
+};
+
+void WriteEntireFileIO(void *param)
+{
+	auto r = (WriteEntireFileIORequest *)param;
+	auto f = OpenFile(r->path, OpenFileWriteOnly | OpenFileCreate, &r->error);
+	if (r->error)
+	{
+		return;
+	}
+	Defer(f.Close());
+	if (!f.Write(r->data))
+	{
+		r->error = true;
+	}
+}
+
+void WriteEntireFileOnIOThread(string::String path, array::View<u8> data, bool *err)
+{
+	auto r = WriteEntireFileIORequest
+	{
+		.path = path,
+		.data = data,
+	};
+	RunOnIOThread(WriteEntireFileIO, &r);
+	if (r.error)
+	{
+		LogError("Job", "Failed to write file %k.", path);
+		*err = true;
+	}
+}
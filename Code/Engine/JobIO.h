@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Job.h"
+#include "Basic/String.h"
+#include "Basic/Container/Array.h"
+
+// Blocking calls (file reads and writes, anything that sleeps in the kernel) made from a job stall the whole worker thread, and that
+// worker's core sits idle for as long as the call takes. These functions hand the call to a dedicated I/O thread instead and suspend only
+// the calling job fiber. The worker picks up other jobs in the meantime, and the fiber is resumed like any other job once the call returns.
+//
+// From outside of a job (a thread that isn't a worker, or a worker's own scheduling fiber), the call is just made directly. Results are
+// allocated from the calling job's context allocator, not the I/O thread's.
+
+void InitializeJobIO();
+void RunOnIOThread(JobProcedure proc, void *param);
+array::Array<u8> ReadEntireFileOnIOThread(string::String path, bool *err);
+void WriteEntireFileOnIOThread(string::String path, array::View<u8> data, bool *err);
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Basic/CPU.h"
+#include "Common.h"
+
+// A fixed-capacity Chase-Lev work-stealing deque. Based on "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al.
+// 2013). Only the owning worker thread may call Push and Pop, which operate on the bottom of the deque. Any thread may call Steal, which
+// takes from the top. The capacity must be a power of two.
+//
+// The elements are copied in and out non-atomically. A thief may read a torn element while racing with the owner, but in that case the
+// thief's compare-and-swap on top fails and the copy is discarded. The owner never overwrites a slot that a thief could still claim
+// because Push refuses to go past the capacity.
+template <typename T, s64 N>
+struct WorkStealingQueue
+{
+	static_assert((N & (N - 1)) == 0, "WorkStealingQueue capacity must be a power of two.");
+
+	volatile s64 top;
+	u8 topPadding[CPUCacheLineSize - sizeof(s64)];
+	volatile s64 bottom;
+	u8 bottomPadding[CPUCacheLineSize - sizeof(s64)];
+	T elements[N];
+
+	bool Push(T e);
+	bool Pop(T *e);
+	bool Steal(T *e);
+	s64 Count();
+};
+
+template <typename T, s64 N>
+bool WorkStealingQueue<T, N>::Push(T e)
+{
+	auto b = __atomic_load_n(&this->bottom, __ATOMIC_RELAXED);
+	auto t = __atomic_load_n(&this->top, __ATOMIC_ACQUIRE);
+	if (b - t >= N)
+	{
+		// Full. The caller has to put the element somewhere else.
+		return false;
+	}
+	this->elements[b & (N - 1)] = e;
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&this->bottom, b + 1, __ATOMIC_RELAXED);
+	return true;
+}
+
+template <typename T, s64 N>
+bool WorkStealingQueue<T, N>::Pop(T *e)
+{
+	auto b = __atomic_load_n(&this->bottom, __ATOMIC_RELAXED) - 1;
+	__atomic_store_n(&this->bottom, b, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	auto t = __atomic_load_n(&this->top, __ATOMIC_RELAXED);
+	if (t > b)
+	{
+		// Empty.
+		__atomic_store_n(&this->bottom, b + 1, __ATOMIC_RELAXED);
+		return false;
+	}
+	*e = this->elements[b & (N - 1)];
+	if (t != b)
+	{
+		// There is more than one element left, so no thief can be racing us for this one.
+		return true;
+	}
+	// This is the last element. Race the thieves for it.
+	auto won = __atomic_compare_exchange_n(&this->top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+	__atomic_store_n(&this->bottom, b + 1, __ATOMIC_RELAXED);
+	return won;
+}
+
+template <typename T, s64 N>
+bool WorkStealingQueue<T, N>::Steal(T *e)
+{
+	auto t = __atomic_load_n(&this->top, __ATOMIC_ACQUIRE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	auto b = __atomic_load_n(&this->bottom, __ATOMIC_ACQUIRE);
+	if (t >= b)
+	{
+		return false;
+	}
+	auto x = this->elements[t & (N - 1)];
+	if (!__atomic_compare_exchange_n(&this->top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+	{
+		// Lost the race to the owner or to another thief.
+		return false;
+	}
+	*e = x;
+	return true;
+}
+
+template <typename T, s64 N>
+s64 WorkStealingQueue<T, N>::Count()
+{
+	// Only an estimate if called from a thread other than the owner.
+	auto b = __atomic_load_n(&this->bottom, __ATOMIC_RELAXED);
+	auto t = __atomic_load_n(&this->top, __ATOMIC_RELAXED);
+	return (b > t) ? b - t : 0;
+}
@@ -0,0 +1,242 @@
+#include "JobSync.h"
+#include "Math.h"
+#include "Basic/Atomic.h"
+#include "Basic/CPU.h"
+
+const auto MinJobLockSpinCount = 16;
+const auto MaxJobLockSpinCount = 1024;
+
+void JobWaitList::Push(JobFiber *f)
+{
+	f->nextWaitingFiber = NULL;
+	if (this->last)
+	{
+		this->last->nextWaitingFiber = f;
+	}
+	else
+	{
+		this->first = f;
+	}
+	this->last = f;
+}
+
+JobFiber *JobWaitList::Pop()
+{
+	auto f = this->first;
+	if (!f)
+	{
+		return NULL;
+	}
+	this->first = f->nextWaitingFiber;
+	if (!this->first)
+	{
+		this->last = NULL;
+	}
+	return f;
+}
+
+// Spins on tryAcquire, adapting *spinLimit as it goes. Returns true if spinning got the resource.
+template <typename F>
+bool SpinToAcquire(s32 *spinLimit, F tryAcquire)
+{
+	// The limit is only a hint, so it's read and written without synchronization.
+	auto limit = Maximum(*spinLimit, MinJobLockSpinCount);
+	for (auto i = 0; i < limit; i += 1)
+	{
+		if (tryAcquire())
+		{
+			*spinLimit = Minimum(limit * 2, MaxJobLockSpinCount);
+			return true;
+		}
+		CPUSpinWaitHint();
+	}
+	*spinLimit = Maximum(limit / 2, MinJobLockSpinCount);
+	return false;
+}
+
+JobMutex NewJobMutex()
+{
+	return
+	{
+		.spinLimit = MinJobLockSpinCount,
+	};
+}
+
+bool JobMutex::TryLock()
+{
+	return this->locked == 0 && AtomicCompareAndSwap32(&this->locked, 0, 1) == 0;
+}
+
+// Runs on the worker after the job fiber suspended in JobMutex::Lock.
+void AddJobMutexWaiter(JobFiber *f, void *param)
+{
+	auto m = (JobMutex *)param;
+	m->waitLock.Lock();
+	if (m->TryLock())
+	{
+		// The mutex was unlocked while we were suspending.
+		m->waitLock.Unlock();
+		ResumeSuspendedJob(f);
+		return;
+	}
+	m->waiters.Push(f);
+	m->waitLock.Unlock();
+}
+
+void JobMutex::Lock()
+{
+	if (this->TryLock() || SpinToAcquire(&this->spinLimit, [this]() { return this->TryLock(); }))
+	{
+		return;
+	}
+	// Unlock hands the mutex straight to the first waiter, so we own it once we are resumed.
+	SuspendRunningJob(AddJobMutexWaiter, this);
+}
+
+void JobMutex::Unlock()
+{
+	Assert(this->locked);
+	this->waitLock.Lock();
+	auto f = this->waiters.Pop();
+	if (!f)
+	{
+		__atomic_store_n(&this->locked, 0, __ATOMIC_RELEASE);
+	}
+	this->waitLock.Unlock();
+	if (f)
+	{
+		ResumeSuspendedJob(f);
+	}
+}
+
+JobSemaphore NewJobSemaphore(s64 count)
+{
+	return
+	{
+		.count = count,
+		.spinLimit = MinJobLockSpinCount,
+	};
+}
+
+bool JobSemaphore::TryWait()
+{
+	auto c = this->count;
+	while (c > 0)
+	{
+		auto old = AtomicCompareAndSwap64(&this->count, c, c - 1);
+		if (old == c)
+		{
+			return true;
+		}
+		c = old;
+	}
+	return false;
+}
+
+void AddJobSemaphoreWaiter(JobFiber *f, void *param)
+{
+	auto s = (JobSemaphore *)param;
+	s->waitLock.Lock();
+	if (s->TryWait())
+	{
+		s->waitLock.Unlock();
+		ResumeSuspendedJob(f);
+		return;
+	}
+	s->waiters.Push(f);
+	s->waitLock.Unlock();
+}
+
+void JobSemaphore::Wait()
+{
+	if (this->TryWait() || SpinToAcquire(&this->spinLimit, [this]() { return this->TryWait(); }))
+	{
+		return;
+	}
+	// Signal hands its count straight to waiters, so there is nothing left to take once we are resumed.
+	SuspendRunningJob(AddJobSemaphoreWaiter, this);
+}
+
+void JobSemaphore::Signal(s64 n)
+{
+	Assert(n > 0);
+	auto resume = JobWaitList{};
+	this->waitLock.Lock();
+	for (; n > 0; n -= 1)
+	{
+		auto f = this->waiters.Pop();
+		if (!f)
+		{
+			break;
+		}
+		resume.Push(f);
+	}
+	if (n > 0)
+	{
+		AtomicAdd64(&this->count, n);
+	}
+	this->waitLock.Unlock();
+	while (auto f = resume.Pop())
+	{
+		ResumeSuspendedJob(f);
+	}
+}
+
+JobConditionVariable NewJobConditionVariable()
+{
+	return {};
+}
+
+struct JobConditionVariableWait
+{
+	JobConditionVariable *conditionVariable;
+	JobMutex *mutex;
+};
+
+void AddJobConditionVariableWaiter(JobFiber *f, void *param)
+{
+	auto w = (JobConditionVariableWait *)param;
+	auto cv = w->conditionVariable;
+	auto m = w->mutex;
+	// Only give up the mutex once we're on the wait list, so a signal sent right after can't be missed.
+	cv->waitLock.Lock();
+	cv->waiters.Push(f);
+	cv->waitLock.Unlock();
+	m->Unlock();
+}
+
+// The mutex must be locked by the caller. It is unlocked while waiting and locked again before returning. Wakeups can be spurious, so
+// callers should recheck their condition in a loop.
+void JobConditionVariable::Wait(JobMutex *m)
+{
+	auto w = JobConditionVariableWait
+	{
+		.conditionVariable = this,
+		.mutex = m,
+	};
+	SuspendRunningJob(AddJobConditionVariableWaiter, &w);
+	m->Lock();
+}
+
+void JobConditionVariable::Signal()
+{
+	this->waitLock.Lock();
+	auto f = this->waiters.Pop();
+	this->waitLock.Unlock();
+	if (f)
+	{
+		ResumeSuspendedJob(f);
+	}
+}
+
+void JobConditionVariable::Broadcast()
+{
+	this->waitLock.Lock();
+	auto resume = this->waiters;
+	this->waiters = {};
+	this->waitLock.Unlock();
+	while (auto f = resume.Pop())
+	{
+		ResumeSuspendedJob(f);
+	}
+}
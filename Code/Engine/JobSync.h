@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Job.h"
+#include "Basic/Thread.h"
+
+// Locks for code running inside of jobs. The OS Mutex and Semaphore block the whole worker thread, and a Spinlock burns the core while it
+// waits. These spin for a little while in case the wait is short, then suspend only the calling job fiber and let the worker run other
+// jobs until the fiber is handed the lock. The slow paths must be called from a job.
+//
+// How long to spin adapts per lock: it grows when spinning pays off and shrinks when the job ends up suspending anyway.
+
+// Waiting fibers are kept in FIFO order, linked through JobFiber::nextWaitingFiber.
+struct JobWaitList
+{
+	JobFiber *first;
+	JobFiber *last;
+
+	void Push(JobFiber *f);
+	JobFiber *Pop();
+};
+
+struct JobMutex
+{
+	volatile s32 locked;
+	s32 spinLimit;
+	Spinlock waitLock; // Guards waiters, and orders unlocking against fibers adding themselves as waiters.
+	JobWaitList waiters;
+
+	void Lock();
+	bool TryLock();
+	void Unlock();
+};
+
+struct JobSemaphore
+{
+	volatile s64 count;
+	s32 spinLimit;
+	Spinlock waitLock;
+	JobWaitList waiters;
+
+	void Wait();
+	bool TryWait();
+	void Signal(s64 n);
+};
+
+struct JobConditionVariable
+{
+	Spinlock waitLock;
+	JobWaitList waiters;
+
+	void Wait(JobMutex *m);
+	void Signal();
+	void Broadcast();
+};
+
+JobMutex NewJobMutex();
+JobSemaphore NewJobSemaphore(s64 count);
+JobConditionVariable NewJobConditionVariable();
@@ -0,0 +1,275 @@
+#include "JobTrace.h"
+#include "Math.h"
+#include "Basic/File.h"
+#include "Basic/Log.h"
+#include "Basic/CPU.h"
+#include "Basic/Memory/GlobalHeap.h"
+#include "Basic/Time/Time.h"
+#include <stdio.h>
+#include <x86intrin.h>
+
+// The number of events each worker keeps. Once a buffer is full the oldest events are overwritten. Must be a power of two.
+const auto JobTraceBufferSize = 1 << 16;
+// The trace file is written in chunks of this size, so writing it while tracing is still running doesn't cost a system call per event.
+const auto JobTraceWriteBufferSize = 256 * 1024;
+// Job names are cut to this length (after escaping), which keeps every event well inside one formatted line.
+const auto JobTraceMaxNameSize = 256;
+const auto JobTraceMaxLineSize = 512;
+
+// Each buffer has a single writer, the worker that owns it. Readers copy events out and then throw away any that the writer could have
+// overwritten in the meantime, so nothing ever has to lock.
+struct JobTraceBuffer
+{
+	volatile s64 writeCount; // Only ever written by the owning worker, and never reset.
+	u8 writeCountPadding[CPUCacheLineSize - sizeof(s64)];
+	s64 startCount; // writeCount when the current trace started. Events before it belong to an earlier trace.
+	JobTraceEvent events[JobTraceBufferSize];
+};
+
+bool jobTraceEnabled = false;
+auto jobTraceBuffers = array::Array<JobTraceBuffer *>{};
+auto jobTraceStartTimestamp = u64{};
+auto jobTraceStartTime = Time::Time{};
+auto jobTraceFramePath = string::String{};
+auto jobTraceFramesLeft = s64{};
+
+void RecordJobTraceEvent(JobTraceEventType t, JobProcedure proc, void *data)
+{
+	// Pairs with the release in StartJobTrace, so the buffers are visible once tracing is seen as enabled.
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	auto i = WorkerThreadIndex();
+	if (i < 0 || i >= jobTraceBuffers.count)
+	{
+		return;
+	}
+	auto b = jobTraceBuffers[i];
+	auto n = b->writeCount;
+	b->events[n & (JobTraceBufferSize - 1)] = JobTraceEvent
+	{
+		.timestamp = __rdtsc(),
+		.type = t,
+		.procedure = proc,
+		.data = data,
+	};
+	__atomic_store_n(&b->writeCount, n + 1, __ATOMIC_RELEASE);
+}
+
+// Starts recording from scratch. Events from an earlier trace are dropped.
+void StartJobTrace()
+{
+	if (jobTraceBuffers.count == 0)
+	{
+		jobTraceBuffers = array::NewIn<JobTraceBuffer *>(Memory::GlobalHeap(), WorkerThreadCount());
+		for (auto &b : jobTraceBuffers)
+		{
+			b = (JobTraceBuffer *)Memory::GlobalHeap()->Allocate(sizeof(JobTraceBuffer));
+			// Nothing records before the first trace is enabled below, so this is the only time a count can be set from outside.
+			b->writeCount = 0;
+		}
+	}
+	// Workers can still be recording if an earlier trace was never stopped, so their counts are left alone. Resetting one under a worker
+	// that is halfway through an event would let it store its stale count right back. Instead we remember where this trace starts.
+	jobTraceStartTimestamp = __rdtsc();
+	jobTraceStartTime = Time::Now();
+	for (auto b : jobTraceBuffers)
+	{
+		b->startCount = __atomic_load_n(&b->writeCount, __ATOMIC_ACQUIRE);
+	}
+	__atomic_store_n(&jobTraceEnabled, true, __ATOMIC_RELEASE);
+}
+
+void StopJobTrace()
+{
+	__atomic_store_n(&jobTraceEnabled, false, __ATOMIC_RELEASE);
+}
+
+// Returns the name of a job procedure, falling back to its address if it isn't an exported symbol.
+const char *JobProcedureName(JobProcedure p, char *buffer, s64 bufferSize)
+{
+	auto info = Dl_info{};
+	if (dladdr((void *)p, &info) && info.dli_sname)
+	{
+		return info.dli_sname;
+	}
+	snprintf(buffer, bufferSize, "Job %p", (void *)p);
+	return buffer;
+}
+
+// Copies s into buffer as the inside of a JSON string. Quotes, backslashes and control characters are escaped, and the name is cut short
+// rather than overflow the buffer, so a long (or odd) symbol name can't break the trace file.
+void EscapeJobTraceName(const char *s, char *buffer, s64 bufferSize)
+{
+	auto n = s64{0};
+	for (; *s; s += 1)
+	{
+		// The longest escape is six bytes, plus the terminator.
+		if (n + 7 > bufferSize)
+		{
+			break;
+		}
+		auto c = *s;
+		if (c == '"' || c == '\\')
+		{
+			buffer[n] = '\\';
+			buffer[n + 1] = c;
+			n += 2;
+		}
+		else if ((u8)c < 0x20)
+		{
+			n += snprintf(buffer + n, bufferSize - n, "\\u%04x", c);
+		}
+		else
+		{
+			buffer[n] = c;
+			n += 1;
+		}
+	}
+	buffer[n] = '\0';
+}
+
+// Can be called while tracing is running. Events that get overwritten while the trace is being copied are left out.
+void WriteJobTrace(string::String path, bool *err)
+{
+	auto file = OpenFile(path, OpenFileWriteOnly | OpenFileCreate, err);
+	if (*err)
+	{
+		LogError("Job", "Failed to open job trace file %k.", path);
+		return;
+	}
+	Defer(file.Close());
+	// The trace format wants microseconds, so calibrate the time stamp counter against the wall clock over the length of the trace.
+	auto ticks = __rdtsc() - jobTraceStartTimestamp;
+	auto nanoseconds = (Time::Now() - jobTraceStartTime).Nanoseconds();
+	auto ticksPerMicrosecond = (nanoseconds > 0) ? (f64)ticks / ((f64)nanoseconds / 1000.0) : 1.0;
+	auto events = array::NewWithCapacityIn<JobTraceEvent>(Memory::GlobalHeap(), JobTraceBufferSize);
+	Defer(events.Free());
+	auto output = (char *)Memory::GlobalHeap()->Allocate(JobTraceWriteBufferSize);
+	Defer(Memory::GlobalHeap()->Deallocate(output));
+	auto outputCount = s64{0};
+	auto Flush = [&]()
+	{
+		if (outputCount > 0 && !file.Write(array::NewView((u8 *)output, outputCount)))
+		{
+			*err = true;
+		}
+		outputCount = 0;
+	};
+	char line[JobTraceMaxLineSize];
+	char procedureName[64];
+	char name[JobTraceMaxNameSize];
+	auto write = [&](s64 n)
+	{
+		// Names are clamped, so a line can only be cut short by a bug in the formats below. A cut line would leave invalid JSON.
+		if (n < 0 || n >= (s64)sizeof(line))
+		{
+			Abort("Job", "Job trace event did not fit in %d bytes.", (s64)sizeof(line));
+		}
+		if (outputCount + n > JobTraceWriteBufferSize)
+		{
+			Flush();
+		}
+		memcpy(output + outputCount, line, n);
+		outputCount += n;
+	};
+	write(snprintf(line, sizeof(line), "{\"traceEvents\":[\n"));
+	auto first = true;
+	for (auto tid = 0; tid < jobTraceBuffers.count; tid += 1)
+	{
+		auto b = jobTraceBuffers[tid];
+		auto end = __atomic_load_n(&b->writeCount, __ATOMIC_ACQUIRE);
+		auto start = Maximum(end - JobTraceBufferSize, b->startCount);
+		events.Resize(0);
+		for (auto i = start; i < end; i += 1)
+		{
+			events.Append(b->events[i & (JobTraceBufferSize - 1)]);
+		}
+		// Anything before this point could have been overwritten while we were copying.
+		auto valid = __atomic_load_n(&b->writeCount, __ATOMIC_ACQUIRE) - JobTraceBufferSize;
+		for (auto i = start; i < end; i += 1)
+		{
+			if (i < valid)
+			{
+				continue;
+			}
+			auto e = events[i - start];
+			// An event that was being recorded as the trace started can be counted in it with a slightly earlier time stamp.
+			if (e.timestamp < jobTraceStartTimestamp)
+			{
+				continue;
+			}
+			auto ts = (f64)(e.timestamp - jobTraceStartTimestamp) / ticksPerMicrosecond;
+			auto sep = first ? "" : ",\n";
+			first = false;
+			switch (e.type)
+			{
+			case JobStartTraceEvent:
+			case JobCounterResumeTraceEvent:
+			{
+				// A resumed job continues in a new slice, possibly on a different worker than the one it started on.
+				EscapeJobTraceName(JobProcedureName(e.procedure, procedureName, sizeof(procedureName)), name, sizeof(name));
+				write(snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"cat\":\"Job\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":0,\"tid\":%d}", sep, name, ts, tid));
+			} break;
+			case JobEndTraceEvent:
+			{
+				write(snprintf(line, sizeof(line), "%s{\"ph\":\"E\",\"ts\":%.3f,\"pid\":0,\"tid\":%d}", sep, ts, tid));
+			} break;
+			case JobCounterWaitTraceEvent:
+			{
+				write(snprintf(line, sizeof(line), "%s{\"ph\":\"E\",\"ts\":%.3f,\"pid\":0,\"tid\":%d,\"args\":{\"waitingOn\":\"%p\"}}", sep, ts, tid, e.data));
+			} break;
+			case JobFiberSwitchTraceEvent:
+			{
+				write(snprintf(line, sizeof(line), "%s{\"name\":\"Fiber Switch\",\"cat\":\"Fiber\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":0,\"tid\":%d,\"args\":{\"fiber\":\"%p\"}}", sep, ts, tid, e.data));
+			} break;
+			case JobStealTraceEvent:
+			{
+				write(snprintf(line, sizeof(line), "%s{\"name\":\"Steal\",\"cat\":\"Job\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":0,\"tid\":%d,\"args\":{\"victim\":%ld}}", sep, ts, tid, (s64)e.data));
+			} break;
+			case FrameTraceEvent:
+			{
+				write(snprintf(line, sizeof(line), "%s{\"name\":\"Frame\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":0,\"tid\":%d}", sep, ts, tid));
+			} break;
+			default:
+			{
+				Abort("Job", "Unknown job trace event type %d.", e.type);
+			} break;
+			}
+		}
+	}
+	write(snprintf(line, sizeof(line), "\n]}\n"));
+	Flush();
+	if (*err)
+	{
+		LogError("Job", "Failed to write job trace file %k.", path);
+	}
+}
+
+// Traces the next frameCount frames and writes them to path.
+void TraceJobFrames(string::String path, s64 frameCount)
+{
+	Assert(frameCount > 0);
+	jobTraceFramePath = path;
+	jobTraceFramesLeft = frameCount;
+	StartJobTrace();
+}
+
+// Called by the game loop once per frame.
+void FinishJobTraceFrame()
+{
+	TraceJobEvent(FrameTraceEvent, NULL, NULL);
+	if (jobTraceFramesLeft == 0)
+	{
+		return;
+	}
+	jobTraceFramesLeft -= 1;
+	if (jobTraceFramesLeft == 0)
+	{
+		StopJobTrace();
+		auto err = false;
+		WriteJobTrace(jobTraceFramePath, &err);
+		if (!err)
+		{
+			LogInfo("Job", "Wrote job trace to %k.", jobTraceFramePath);
+		}
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Job.h"
+#include "Basic/String.h"
+
+// A tracer for the job system that is always compiled in. Workers append events to their own ring buffer, stamped with the CPU's time stamp
+// counter, and the buffers are converted to Chrome trace event JSON when the trace is written. Perfetto (ui.perfetto.dev) and
+// chrome://tracing both open the output.
+//
+// When tracing is off, the cost at every trace point is one well-predicted branch on jobTraceEnabled.
+
+enum JobTraceEventType
+{
+	JobStartTraceEvent,
+	JobEndTraceEvent,
+	JobFiberSwitchTraceEvent,
+	JobCounterWaitTraceEvent,
+	JobCounterResumeTraceEvent,
+	JobStealTraceEvent,
+	FrameTraceEvent,
+};
+
+struct JobTraceEvent
+{
+	u64 timestamp;
+	JobTraceEventType type;
+	JobProcedure procedure;
+	void *data; // The job counter for wait and resume events, the victim worker index for steal events.
+};
+
+extern bool jobTraceEnabled;
+
+void RecordJobTraceEvent(JobTraceEventType t, JobProcedure proc, void *data);
+
+inline void TraceJobEvent(JobTraceEventType t, JobProcedure proc, void *data)
+{
+	if (__builtin_expect(__atomic_load_n(&jobTraceEnabled, __ATOMIC_RELAXED), false))
+	{
+		RecordJobTraceEvent(t, proc, data);
+	}
+}
+
+void StartJobTrace();
+void StopJobTrace();
+void WriteJobTrace(string::String path, bool *err);
+void TraceJobFrames(string::String path, s64 frameCount);
+void FinishJobTraceFrame();
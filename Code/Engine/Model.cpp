@@ -1,7 +1,9 @@
 #include "Model.h"
 #include "GLTF.h"
+#include "JobIO.h"
 #include "Basic/File.h"
 #include "Basic/Filepath.h"
+#include "Basic/Container/Array.h"
 #include "Basic/Container/Map.h"
 #include "Basic/Hash.h"
 #include "Basic/Parser.h"
@@ -10,7 +12,7 @@
 #ifdef DevelopmentBuild
 	const auto ModelDirectory = string::Make("Data/Model");
 
-	auto modelFilepaths = map::New<string::String, string::String>(0, HashString);
+	auto modelFilepaths = map::NewConcurrent<string::String, string::String>(0, HashString);
 #endif
 
 void InitializeModelAssets()
@@ -20,6 +22,7 @@ void InitializeModelAssets()
 		auto itr = DirectoryIteration{};
 		while (itr.Iterate(ModelDirectory))
 		{
+			auto scratch = Memory::ScratchScope{};
 			if (!itr.isDirectory)
 			{
 				LogVerbose("Model", "File %k is not a directory, skipping.", itr.filename);
@@ -39,34 +42,54 @@ void InitializeModelAssets()
 }
 
 const auto MeshAssetCount = 1;
+const auto InlineSubmeshCount = 8; // Most meshes have only a few primitives.
 const auto MeshCount = 2;
-auto meshAssets = array::New<GPUMeshAsset>(MeshAssetCount);
-auto meshes = array::New<GPUMesh>(MeshCount);
+// The asset tables point into each other (meshes at their mesh asset, render packets at their mesh), so they are virtual arrays that
+// never move their elements when they grow. These are the most each table can ever hold.
+const auto MaxMeshAssetCount = 64 * 1024;
+const auto MaxMeshCount = 1024 * 1024;
+auto meshAssets = []() -> array::Virtual<GPUMeshAsset>
+{
+	auto a = array::NewVirtual<GPUMeshAsset>(MaxMeshAssetCount);
+	a.Resize(MeshAssetCount);
+	return a;
+}();
+auto meshes = []() -> array::Virtual<GPUMesh>
+{
+	auto a = array::NewVirtual<GPUMesh>(MaxMeshCount);
+	a.Resize(MeshCount);
+	return a;
+}();
 auto materials = GPUMaterial{};
-auto renderPackets = array::New<GPURenderPacket>(MeshCount);
+auto renderPackets = []() -> array::Virtual<GPURenderPacket>
+{
+	auto a = array::NewVirtual<GPURenderPacket>(MaxMeshCount);
+	a.Resize(MeshCount);
+	return a;
+}();
 
 #include "Vulkan/StagingBuffer.h"
 
 ModelAsset LoadModelAssetFromFile(string::String name)
 {
-	auto gltfPath = modelFilepaths.Lookup(name);
-	if (!gltfPath)
+	auto gltfPath = string::String{};
+	if (!modelFilepaths.Lookup(name, &gltfPath))
 	{
 		LogError("Model", "Failed to find a registered file path for %k, skipping load.", name);
 		return ModelAsset{};
 	}
 	auto err = false;
-	auto gltf = ParseGLTFFile(*gltfPath, &err);
+	auto gltf = ParseGLTFFile(gltfPath, &err);
 	if (err)
 	{
-		LogError("Model", "Failed to parse glTF file for %k, skipping load.", *gltfPath);
+		LogError("Model", "Failed to parse glTF file for %k, skipping load.", gltfPath);
 		return ModelAsset{};
 	}
 	auto buffers = array::Array<array::Array<u8>>{};
 	for (auto b : gltf.buffers)
 	{
-		auto p = JoinFilepaths(FilepathDirectory(*gltfPath), b.uri);
-		auto f = ReadEntireFile(p, &err);
+		auto p = JoinFilepaths(FilepathDirectory(gltfPath), b.uri);
+		auto f = ReadEntireFileOnIOThread(p, &err);
 		if (err)
 		{
 			LogError("Model", "Failed to read glTF URI file %k.", p);
@@ -79,7 +102,7 @@ ModelAsset LoadModelAssetFromFile(string::String name)
 	auto vertexCount = 0;
 	for (auto m : gltf.meshes)
 	{
-		auto submeshes = array::NewWithCapacity<u32>(m.primitives.count);
+		auto submeshes = array::Small<u32, InlineSubmeshCount>{};
 		for (auto p : m.primitives)
 		{
 			auto acc = &gltf.accessors[p.indices];
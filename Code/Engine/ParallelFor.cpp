@@ -0,0 +1,8 @@
+#include "ParallelFor.h"
+
+s64 ParallelForChunkCount(s64 count, s64 minChunkSize)
+{
+	Assert(minChunkSize > 0);
+	auto maxChunks = WorkerThreadCount() * ParallelForChunksPerWorker;
+	return Maximum(1, Minimum(count / minChunkSize, maxChunks));
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "Job.h"
+#include "Math.h"
+#include "Basic/Container/Array.h"
+
+// Data-parallel loops on top of the job system. The work is split into chunks, every chunk but the last is run as a job on a single
+// counter, and the calling job runs the last chunk itself before waiting on the rest. Must be called from inside a job, since it waits on
+// a JobCounter.
+//
+// minChunkSize is the smallest number of items worth the overhead of a job. Small loops never leave the calling fiber.
+
+// Oversubscribe the workers a bit so that uneven chunks balance out through stealing.
+const auto ParallelForChunksPerWorker = 4;
+
+s64 ParallelForChunkCount(s64 count, s64 minChunkSize);
+
+template <typename F>
+struct ParallelForChunk
+{
+	F *procedure;
+	s64 start;
+	s64 end;
+};
+
+template <typename F>
+void RunParallelForChunk(void *param)
+{
+	auto c = (ParallelForChunk<F> *)param;
+	(*c->procedure)(c->start, c->end);
+}
+
+// Calls f(start, end) for disjoint ranges that cover [0, count).
+template <typename F>
+void ParallelForRange(s64 count, s64 minChunkSize, F f)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+	auto chunkCount = ParallelForChunkCount(count, minChunkSize);
+	if (chunkCount == 1)
+	{
+		f(0, count);
+		return;
+	}
+	auto chunkSize = DivideAndRoundUp(count, chunkCount);
+	chunkCount = DivideAndRoundUp(count, chunkSize);
+	auto chunks = array::NewWithCapacity<ParallelForChunk<F>>(chunkCount - 1);
+	auto jobs = array::NewWithCapacity<JobDeclaration>(chunkCount - 1);
+	Defer(
+	{
+		chunks.Free();
+		jobs.Free();
+	});
+	for (auto i = 0; i < chunkCount - 1; i += 1)
+	{
+		chunks.Append(
+		{
+			.procedure = &f,
+			.start = i * chunkSize,
+			.end = (i + 1) * chunkSize,
+		});
+		jobs.Append(NewJobDeclaration(RunParallelForChunk<F>, &chunks[i]));
+	}
+	auto counter = (JobCounter *){};
+	RunJobs(jobs, RunningJobPriority(), &counter);
+	f((chunkCount - 1) * chunkSize, count);
+	counter->Wait();
+	counter->Free();
+}
+
+// Calls f(i) for every i in [0, count).
+template <typename F>
+void ParallelFor(s64 count, s64 minChunkSize, F f)
+{
+	ParallelForRange(count, minChunkSize, [&f](s64 start, s64 end)
+	{
+		for (auto i = start; i < end; i += 1)
+		{
+			f(i);
+		}
+	});
+}
+
+// Calls f(e) for every element of v.
+template <typename T, typename F>
+void ParallelFor(array::View<T> v, s64 minChunkSize, F f)
+{
+	ParallelForRange(v.count, minChunkSize, [&v, &f](s64 start, s64 end)
+	{
+		for (auto i = start; i < end; i += 1)
+		{
+			f(v[i]);
+		}
+	});
+}
+
+// Maps every i in [0, count) with f(i) and folds the results together with combine, starting from identity. Each chunk reduces into its
+// own slot and the slots are combined in order on the calling fiber, so the result doesn't depend on scheduling as long as combine is
+// associative.
+template <typename R, typename F, typename C>
+R ParallelReduce(s64 count, s64 minChunkSize, R identity, F f, C combine)
+{
+	if (count <= 0)
+	{
+		return identity;
+	}
+	auto chunkCount = ParallelForChunkCount(count, minChunkSize);
+	auto chunkSize = DivideAndRoundUp(count, chunkCount);
+	chunkCount = DivideAndRoundUp(count, chunkSize);
+	auto partials = array::New<R>(chunkCount);
+	Defer(partials.Free());
+	ParallelForRange(chunkCount, 1, [&](s64 firstChunk, s64 lastChunk)
+	{
+		for (auto c = firstChunk; c < lastChunk; c += 1)
+		{
+			auto r = identity;
+			auto end = Minimum((c + 1) * chunkSize, count);
+			for (auto i = c * chunkSize; i < end; i += 1)
+			{
+				r = combine(r, f(i));
+			}
+			partials[c] = r;
+		}
+	});
+	auto r = identity;
+	for (auto p : partials)
+	{
+		r = combine(r, p);
+	}
+	return r;
+}
@@ -2,10 +2,14 @@
 #include "Shader.h"
 #include "ShaderGlobal.h"
 #include "Camera.h"
+#include "ParallelFor.h"
+#include "FrameAllocator.h"
 #include "Media/Input.h"
 #include "Basic/File.h"
 #include "Basic/Filepath.h"
 #include "Basic/Log.h"
+#include "Basic/Memory/GlobalHeap.h"
+#include "Basic/Memory/ContextAllocator.h"
 
 s64 RenderWidth()
 {
@@ -23,6 +27,8 @@ auto objectPos = array::Array<V3>{};
 
 #include "Vulkan/GPU.h"
 
+static_assert(FrameAllocatorFrameCount == GPU::Vulkan::MaxFramesInFlight + 1);
+
 auto gpu = GPU::GPU{};
 auto modelShader = GPU::Shader{};
 
@@ -78,7 +84,7 @@ void UpdateRenderUniforms(Camera *c)
 	auto p = InfinitePerspectiveProjectionMatrix(0.01f, c->fov, renderAspectRatio);
 	auto v = ViewMatrix(c->transform.position, c->transform.rotation.Forward());
 	auto pv = p * v;
-	static auto rots = array::Array<Quaternion>{};
+	static auto rots = array::NewIn<Quaternion>(Memory::GlobalHeap(), 0);
 	if (rots.count == 0)
 	{
 		for (auto i = 0; i < MeshCount; i += 1)
@@ -93,16 +99,23 @@ void UpdateRenderUniforms(Camera *c)
 			rots[i] = NewQuaternion(V3{(f32)rand() / (f32)RAND_MAX, (f32)rand() / (f32)RAND_MAX, (f32)rand() / (f32)RAND_MAX});
 		}
 	}
-	auto sb = gpu.NewStagingBuffer();
-	for (auto i = 0; i < MeshCount; i += 1)
+	// Build the matrices in parallel, but map the staging buffer on this fiber since it isn't thread safe.
+	auto mvps = array::New<M4>(MeshCount);
+	ParallelFor(MeshCount, 64, [&](s64 i)
 	{
 		auto m = IdentityMatrix;
 		m.SetRotation(rots[i].Matrix());
 		m.SetTranslation(objectPos[i]);
+		mvps[i] = pv * m;
+	});
+	auto sb = gpu.NewStagingBuffer();
+	for (auto i = 0; i < MeshCount; i += 1)
+	{
 		sb.MapBuffer(meshes[i].uniform, 0);
-		*(M4 *)sb.map = pv * m;
+		*(M4 *)sb.map = mvps[i];
 	}
 	sb.Flush();
+	mvps.Free();
 	//auto mat = GPUMaterialUniforms
 	//{
 		//.color = V4{1.0f, 0.0f, 0.0f, 1.0f},
@@ -171,23 +184,13 @@ void UpdateRenderUniforms(Camera *c)
 
 void Render()
 {
-/*
-	auto sys = SystemAllocator{};
-	auto pool = NewPoolAllocator(MegabytesToBytes(4), 1, &sys, &sys);
-	PushContextAllocator(&pool);
+	Memory::PushContextAllocator(FrameAllocator());
+	Memory::PushAllocationTag("Render");
 	Defer(
 	{
-		PopContextAllocator();
-		for (auto b : pool.blocks.used)
-		{
-			sys.Deallocate(b);
-		}
-		for (auto b : pool.blocks.unused)
-		{
-			sys.Deallocate(b);
-		}
+		Memory::PopAllocationTag();
+		Memory::PopContextAllocator();
 	});
-*/
 	gpu.BeginFrame();
 	auto culledMeshes = meshes;
 //	auto culledMeshes = Array<GPUMesh>{};
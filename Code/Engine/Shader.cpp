@@ -33,9 +33,9 @@ SPIRV VulkanGLSL(string::String filename, bool *err)
 		return {};
 	}
 	Defer(procFile.Close());
-	auto stageFlags = array::Array<VkShaderStageFlagBits>{};
-	auto stageDefines = array::Array<string::String>{};
-	auto stageExts = array::Array<string::String>{};
+	auto stageFlags = array::Small<VkShaderStageFlagBits, ShaderInlineStageCount>{};
+	auto stageDefines = array::Small<string::String, ShaderInlineStageCount>{};
+	auto stageExts = array::Small<string::String, ShaderInlineStageCount>{};
 	auto fileParser = parser::NewFromFile(shaderPath, "", err);
 	if (*err)
 	{
@@ -8,10 +8,13 @@ namespace ShaderCompiler
 
 #ifdef VulkanBuild
 
+// Shaders have a vertex and fragment stage, or a compute stage.
+const auto ShaderInlineStageCount = 4;
+
 struct SPIRV
 {
 	array::Array<array::Array<u8>> stageByteCode;
-	array::Array<VkShaderStageFlagBits> stages;
+	array::Small<VkShaderStageFlagBits, ShaderInlineStageCount> stages;
 };
 
 SPIRV VulkanGLSL(string::String filename, bool *err);
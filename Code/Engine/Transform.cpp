@@ -1,4 +1,8 @@
 #include "Transform.h"
+#include "ParallelFor.h"
+
+// Rotating a transform is cheap, so only hand out jobs for big batches.
+const auto MinParallelTransformCount = 256;
 
 V3 Transform::Right()
 {
@@ -38,14 +42,14 @@ void Transform::RotateAxisAngleWorld(AxisAngle aa)
 void RotateTransformsEulerLocal(array::View<EulerAngles> eas, array::View<Transform> out)
 {
 	Assert(eas.count == out.count);
-	for (auto i = 0; i < out.count; i += 1)
+	ParallelFor(out.count, MinParallelTransformCount, [&](s64 i)
 	{
 		auto e = out[i].rotation.Euler();
 		auto yaw = EulerAngles{.yaw = e.yaw + eas[i].yaw}.ToQuaternion();
 		auto pitch = EulerAngles{.pitch = e.pitch + eas[i].pitch}.ToQuaternion();
 		auto roll = EulerAngles{.roll = e.roll + eas[i].roll}.ToQuaternion();
 		out[i].rotation = (yaw * pitch * roll).Normal();
-	}
+	});
 }
 
 void RotateTransformsEulerWorld(array::View<EulerAngles> eas, array::View<Transform> out)
@@ -116,7 +116,7 @@ VkPipeline NewPipeline(Device d, VkPipelineLayout l, string::String shaderFilena
 			.dynamicStateCount = (u32)dynStates.Count(),
 			.pDynamicStates = dynStates.elements,
 		};
-		auto stageCIs = array::Array<VkPipelineShaderStageCreateInfo>{};
+		auto stageCIs = array::Small<VkPipelineShaderStageCreateInfo, ShaderCompiler::ShaderInlineStageCount>{};
 		for (auto i = 0; i < modules.count; i += 1)
 		{
 			stageCIs.Append(
@@ -132,7 +132,7 @@ VkPipeline NewPipeline(Device d, VkPipelineLayout l, string::String shaderFilena
 		{
 			.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
 			.stageCount = (u32)stageCIs.count,
-			.pStages = stageCIs.elements,
+			.pStages = stageCIs.Elements(),
 			.pVertexInputState = &vertexCI,
 			.pInputAssemblyState = &assemblyCI,
 			.pViewportState = &viewportCI,
@@ -2,13 +2,15 @@
 
 #ifdef VulkanBuild
 
+#include "../Shader.h"
+
 namespace GPU::Vulkan
 {
 
 struct Shader
 {
-	array::Array<VkShaderStageFlagBits> vkStages;
-	array::Array<VkShaderModule> vkModules;
+	array::Small<VkShaderStageFlagBits, ShaderCompiler::ShaderInlineStageCount> vkStages;
+	array::Small<VkShaderModule, ShaderCompiler::ShaderInlineStageCount> vkModules;
 	VkRenderPass vkRenderPass;
 	VkPipeline vkPipeline;
 };